@@ -0,0 +1,286 @@
+/*
+ * autotune.c - Searches blocked transpose configurations (see blocking.h)
+ *     for the one with the fewest misses on a given M, N and cache
+ *     geometry, and writes it out as a specialized kernel.
+ *
+ * Every candidate is turned into a loop nest and its address stream is
+ * run through the csim engine in-process, so no candidate is compiled or
+ * traced. Candidates are spread over worker threads, each with its own
+ * cache. The matrix bases are the ones ./tracegen-cap -m reports for
+ * the size, so the misses match what test-trans -c measures; -A/-B
+ * override them.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include "csim.h"
+#include "loopnest.h"
+#include "blocking.h"
+
+/* Used only when ./tracegen-cap can't be asked for its bases */
+#define DEFAULT_ABASE 0x4061a0ULL
+#define DEFAULT_BBASE 0x4461a0ULL
+
+typedef struct candidate {
+    blocking cfg;
+    cache_performance perf;
+    unsigned long long accesses;
+    int index;
+    int failed;
+} candidate;
+
+/* Search settings and the shared work queue */
+static int M, N, s = 5, E = 1, b = 5;
+static unsigned long long abase = DEFAULT_ABASE, bbase = DEFAULT_BBASE;
+static candidate *candidates;
+static int num_candidates, next_candidate;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct sim_ctx {
+    cache *sim_cache;
+    cache_performance perf;
+    location loc;
+} sim_ctx;
+
+static void simulate_sink(void *arg, char type, unsigned long long addr, int size)
+{
+    sim_ctx *ctx = arg;
+    simulate_access(&ctx->perf, ctx->sim_cache, &ctx->loc, type, addr);
+}
+
+/*
+ * score - Simulate one candidate on a cold cache
+ */
+static void score(candidate *c)
+{
+    char err[256];
+    char *text = blocking_loopnest(M, N, &c->cfg, abase, bbase);
+    ln_program *prog = text ? ln_parse_string(text, NULL, err, sizeof(err)) : NULL;
+    sim_ctx ctx = {0};
+
+    free(text);
+    if (prog == NULL) {
+        c->failed = 1;
+        return;
+    }
+    setup_cache(&ctx.sim_cache, s, E, b, 64 - (s + b));
+    c->accesses = ln_run(prog, simulate_sink, &ctx);
+    c->perf = ctx.perf;
+    free_cache(&ctx.sim_cache);
+    ln_free(prog);
+}
+
+static void *worker(void *arg)
+{
+    for (;;) {
+        pthread_mutex_lock(&queue_lock);
+        int i = next_candidate++;
+        pthread_mutex_unlock(&queue_lock);
+        if (i >= num_candidates)
+            return NULL;
+        score(&candidates[i]);
+    }
+}
+
+/*
+ * enumerate - Every valid configuration with blocks up to max_h x max_w.
+ *     Returns the number written to out, or the number needed if out is NULL.
+ */
+static int enumerate(candidate *out, int max_h, int max_w)
+{
+    int count = 0;
+
+    for (int bh = 1; bh <= max_h; bh++)
+        for (int bw = 1; bw <= max_w; bw++)
+            for (int order = BLOCK_ROWS; order <= BLOCK_COLS; order++)
+                for (int inner = INNER_ROWS; inner <= INNER_COLS; inner++)
+                    for (int copy = COPY_DIRECT; copy <= COPY_BUFFER; copy++)
+                        for (int diag = DIAG_SAME; diag <= DIAG_BUFFER; diag++) {
+                            blocking cfg = {bh, bw, order, inner, copy, diag};
+                            if (!blocking_valid(M, N, &cfg))
+                                continue;
+                            if (out) {
+                                out[count].cfg = cfg;
+                                out[count].index = count;
+                            }
+                            count++;
+                        }
+    return count;
+}
+
+/* Fewest misses first, then fewest evictions; earlier candidates win ties */
+static int compare_candidates(const void *x, const void *y)
+{
+    const candidate *c = x, *d = y;
+
+    if (c->failed != d->failed)
+        return c->failed - d->failed;
+    if (c->perf.misses != d->perf.misses)
+        return c->perf.misses < d->perf.misses ? -1 : 1;
+    if (c->perf.evictions != d->perf.evictions)
+        return c->perf.evictions < d->perf.evictions ? -1 : 1;
+    return c->index - d->index;
+}
+
+/*
+ * write_kernel - Write the winning configuration as a transpose function
+ *     ready to paste into trans.c, with the line that registers it.
+ */
+static int write_kernel(const char *path, const char *name, candidate *best)
+{
+    char params[128];
+    FILE *out = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+
+    if (out == NULL) {
+        printf("Error: can't write \"%s\"\n", path);
+        return -1;
+    }
+    blocking_describe(&best->cfg, params, sizeof(params));
+    fprintf(out, "/*\n * %s - %dx%d transpose found by autotune for s=%d, E=%d, b=%d\n", name, M, N, s, E, b);
+    fprintf(out, " *     (%d simulated misses). Register it with\n", best->perf.misses);
+    fprintf(out, " *     registerTransFunctionInfo(%s, %s_desc,\n", name, name);
+    fprintf(out, " *         \"%s\", \"tuned\", 1);\n */\n", params);
+    fprintf(out, "char %s_desc[] = \"Tuned %dx%d transpose (%s)\";\n", name, M, N, params);
+    blocking_emit_c(out, name, M, N, &best->cfg, 0);
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
+
+/*
+ * tracer_bases - Ask ./tracegen-cap where it puts A and B for an M x N
+ *     transpose. Returns 0 on success, -1 if it can't be run or its
+ *     output can't be parsed.
+ */
+static int tracer_bases(unsigned long long *a_base, unsigned long long *b_base)
+{
+    char cmd[64];
+    FILE *fp;
+    int ok;
+
+    snprintf(cmd, sizeof(cmd), "./tracegen-cap -M %d -N %d -m 2>/dev/null", M, N);
+    if ((fp = popen(cmd, "r")) == NULL)
+        return -1;
+    ok = fscanf(fp, "A %llx B %llx", a_base, b_base) == 2;
+    if (pclose(fp) != 0 || !ok)
+        return -1;
+    return 0;
+}
+
+static void usage(char *argv[])
+{
+    printf("Usage: %s [-hv] -M <rows> -N <cols> [-s <s> -E <E> -b <b>] [-j <threads>] [-k <top>]\n"
+           "       [-H <max height>] [-W <max width>] [-A <base> -B <base>] [-o <file>] [-n <name>]\n", argv[0]);
+    printf("  -M/-N      matrix size (A is N x M)\n");
+    printf("  -s/-E/-b   cache geometry to tune for (default 5/1/5)\n");
+    printf("  -j <n>     worker threads (default: one per CPU)\n");
+    printf("  -k <n>     list the n best configurations (default 10)\n");
+    printf("  -H/-W      largest block height and width to try (default 16)\n");
+    printf("  -A/-B      addresses of A and B (default: ./tracegen-cap -m's, else %#llx/%#llx)\n",
+           DEFAULT_ABASE, DEFAULT_BBASE);
+    printf("  -o <file>  write the best configuration as a C kernel (- for stdout)\n");
+    printf("  -n <name>  name of the kernel (default transpose_tuned_<M>x<N>)\n");
+    printf("  -v         also print the best configuration's loop nest\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = sysconf(_SC_NPROCESSORS_ONLN), top = 10, max_h = 16, max_w = 16, verbose = 0;
+    char *kernel_path = NULL, *name = NULL;
+    char default_name[64], params[128];
+    int c, have_abase = 0, have_bbase = 0;
+
+    while ((c = getopt(argc, argv, "hvM:N:s:E:b:j:k:H:W:A:B:o:n:")) != -1) {
+        switch (c) {
+        case 'M': M = atoi(optarg); break;
+        case 'N': N = atoi(optarg); break;
+        case 's': s = atoi(optarg); break;
+        case 'E': E = atoi(optarg); break;
+        case 'b': b = atoi(optarg); break;
+        case 'j': threads = atoi(optarg); break;
+        case 'k': top = atoi(optarg); break;
+        case 'H': max_h = atoi(optarg); break;
+        case 'W': max_w = atoi(optarg); break;
+        case 'A': abase = strtoull(optarg, NULL, 0); have_abase = 1; break;
+        case 'B': bbase = strtoull(optarg, NULL, 0); have_bbase = 1; break;
+        case 'o': kernel_path = optarg; break;
+        case 'n': name = optarg; break;
+        case 'v': verbose = 1; break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+    if (M < 1 || N < 1 || s < 0 || E < 1 || b < 0 || s + b > 63 || max_h < 1 || max_w < 1) {
+        usage(argv);
+        exit(1);
+    }
+    if (threads < 1)
+        threads = 1;
+    if (name == NULL) {
+        snprintf(default_name, sizeof(default_name), "transpose_tuned_%dx%d", M, N);
+        name = default_name;
+    }
+    if (!have_abase || !have_bbase) {
+        unsigned long long tracer_a, tracer_b;
+        if (tracer_bases(&tracer_a, &tracer_b) == 0) {
+            if (!have_abase)
+                abase = tracer_a;
+            if (!have_bbase)
+                bbase = tracer_b;
+        } else {
+            printf("Warning: couldn't run ./tracegen-cap -m; using A=%#llx B=%#llx, which may not\n"
+                   "         match the tracer (set them with -A/-B)\n", abase, bbase);
+        }
+    }
+
+    num_candidates = enumerate(NULL, max_h, max_w);
+    if ((candidates = calloc(num_candidates, sizeof(candidate))) == NULL) {
+        printf("Error: out of memory\n");
+        exit(1);
+    }
+    enumerate(candidates, max_h, max_w);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_t tids[threads];
+    for (int i = 0; i < threads; i++)
+        pthread_create(&tids[i], NULL, worker, NULL);
+    for (int i = 0; i < threads; i++)
+        pthread_join(tids[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    qsort(candidates, num_candidates, sizeof(candidate), compare_candidates);
+    if (candidates[0].failed) {
+        printf("Error: no configuration could be simulated\n");
+        exit(1);
+    }
+
+    printf("%dx%d on s=%d, E=%d, b=%d: %d configurations in %.2fs with %d threads\n",
+           M, N, s, E, b, num_candidates, seconds, threads);
+    printf("%6s %6s %10s  %s\n", "misses", "hits", "evictions", "configuration");
+    for (int i = 0; i < top && i < num_candidates && !candidates[i].failed; i++) {
+        blocking_describe(&candidates[i].cfg, params, sizeof(params));
+        printf("%6d %6d %10d  %s\n", candidates[i].perf.misses, candidates[i].perf.hits,
+               candidates[i].perf.evictions, params);
+    }
+
+    if (verbose) {
+        char *text = blocking_loopnest(M, N, &candidates[0].cfg, abase, bbase);
+        printf("\n%s", text ? text : "");
+        free(text);
+    }
+    if (kernel_path && write_kernel(kernel_path, name, &candidates[0]) < 0)
+        exit(1);
+    free(candidates);
+    return 0;
+}
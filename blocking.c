@@ -0,0 +1,314 @@
+/*
+ * blocking.c - Loop-nest and C output for blocked transpose configurations
+ *     (see blocking.h).
+ *
+ * Both outputs come from the same walk over the blocks, which calls a
+ * small emitter for every loop, copy, load into a local and store from
+ * one. Buffered copies are unrolled in both, since C locals can't be
+ * indexed, and whole blocks can be unrolled on request.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "blocking.h"
+
+#define EXPR_LEN 32
+
+typedef struct emitter {
+    FILE *out;
+    int c;      /* write C rather than a loop-nest description */
+    int depth;  /* indentation level */
+    int unroll; /* write every element of a block out, rather than loops */
+} emitter;
+
+static void em_indent(emitter *em)
+{
+    fprintf(em->out, "%*s", (em->c ? 4 : 2) * em->depth, "");
+}
+
+static void em_for(emitter *em, const char *var, const char *lo, const char *hi, int step)
+{
+    em_indent(em);
+    if (!em->c)
+        fprintf(em->out, "for %s %s %s %d\n", var, lo, hi, step);
+    else if (step == 1)
+        fprintf(em->out, "for (int %s = %s; %s < %s; %s++) {\n", var, lo, var, hi, var);
+    else
+        fprintf(em->out, "for (int %s = %s; %s < %s; %s += %d) {\n", var, lo, var, hi, var, step);
+    em->depth++;
+}
+
+static void em_end(emitter *em)
+{
+    em->depth--;
+    em_indent(em);
+    fprintf(em->out, em->c ? "}\n" : "end\n");
+}
+
+/* B[j][i] = A[i][j] */
+static void em_copy(emitter *em, const char *i, const char *j)
+{
+    em_indent(em);
+    if (em->c) {
+        fprintf(em->out, "B[%s][%s] = A[%s][%s];\n", j, i, i, j);
+    } else {
+        fprintf(em->out, "load A %s %s\n", i, j);
+        em_indent(em);
+        fprintf(em->out, "store B %s %s\n", j, i);
+    }
+}
+
+/* tk = A[i][j] */
+static void em_load(emitter *em, int k, const char *i, const char *j)
+{
+    em_indent(em);
+    if (em->c)
+        fprintf(em->out, "int t%d = A[%s][%s];\n", k, i, j);
+    else
+        fprintf(em->out, "load A %s %s\n", i, j);
+}
+
+/* B[j][i] = tk */
+static void em_store(emitter *em, int k, const char *i, const char *j)
+{
+    em_indent(em);
+    if (em->c)
+        fprintf(em->out, "B[%s][%s] = t%d;\n", j, i, k);
+    else
+        fprintf(em->out, "store B %s %s\n", j, i);
+}
+
+/* base+off, folded when base is a number */
+static char *expr(char *buf, const char *base, int off)
+{
+    if (isdigit((unsigned char) base[0]))
+        snprintf(buf, EXPR_LEN, "%d", atoi(base) + off);
+    else if (off == 0)
+        snprintf(buf, EXPR_LEN, "%s", base);
+    else
+        snprintf(buf, EXPR_LEN, "%s+%d", base, off);
+    return buf;
+}
+
+/*
+ * emit_block - Copy the h x w block of A whose top left corner is (bi, bj).
+ *     On a diagonal block bi and bj are the same variable. When unrolling,
+ *     every element is written out at a constant offset from the corner.
+ */
+static void emit_block(emitter *em, const blocking *cfg, const char *bi, const char *bj, int h, int w, int diagonal)
+{
+    int rows = cfg->inner_order == INNER_ROWS;
+    const char *ov = rows ? "i" : "j", *iv = rows ? "j" : "i";
+    const char *olo = rows ? bi : bj, *ilo = rows ? bj : bi;
+    int olen = rows ? h : w, ilen = rows ? w : h;
+    char hi[EXPR_LEN], e[EXPR_LEN], obuf[EXPR_LEN];
+    enum diag_strategy how = DIAG_SAME;
+
+    if (diagonal)
+        how = cfg->diag;
+    if (how == DIAG_SAME && cfg->copy == COPY_BUFFER)
+        how = DIAG_BUFFER;
+
+    /* A block one row (or column) deep needs no loop over it */
+    const char *o = olo;
+    if (olen > 1 && !em->unroll) {
+        em_for(em, ov, olo, expr(hi, olo, olen), 1);
+        o = ov;
+    }
+    for (int r = 0; r < (em->unroll ? olen : 1); r++) {
+        /* Unrolled rows that use locals each get their own scope */
+        int scope = em->unroll && em->c && how != DIAG_SAME;
+        if (em->unroll)
+            o = expr(obuf, olo, r);
+        if (scope) {
+            em_indent(em);
+            fprintf(em->out, "{\n");
+            em->depth++;
+        }
+        switch (how) {
+        case DIAG_SAME:
+            if (em->unroll) {
+                for (int k = 0; k < ilen; k++) {
+                    expr(e, ilo, k);
+                    em_copy(em, rows ? o : e, rows ? e : o);
+                }
+                break;
+            }
+            if (ilen > 1)
+                em_for(em, iv, ilo, expr(hi, ilo, ilen), 1);
+            em_copy(em, rows ? o : (ilen > 1 ? iv : ilo), rows ? (ilen > 1 ? iv : ilo) : o);
+            if (ilen > 1)
+                em_end(em);
+            break;
+        case DIAG_BUFFER:
+            for (int k = 0; k < ilen; k++) {
+                expr(e, ilo, k);
+                em_load(em, k, rows ? o : e, rows ? e : o);
+            }
+            for (int k = 0; k < ilen; k++) {
+                expr(e, ilo, k);
+                em_store(em, k, rows ? o : e, rows ? e : o);
+            }
+            break;
+        case DIAG_DEFER:
+            /* Leave the element on the diagonal, whose line in B conflicts with A's, for last */
+            if (em->unroll) {
+                for (int k = 0; k < ilen; k++) {
+                    if (k != r)
+                        em_copy(em, rows ? o : expr(e, ilo, k), rows ? expr(e, ilo, k) : o);
+                    else
+                        em_load(em, 0, o, o);
+                }
+                em_store(em, 0, o, o);
+                break;
+            }
+            em_for(em, iv, ilo, o, 1);
+            em_copy(em, rows ? o : iv, rows ? iv : o);
+            em_end(em);
+            em_load(em, 0, o, o);
+            em_for(em, iv, expr(e, o, 1), expr(hi, ilo, ilen), 1);
+            em_copy(em, rows ? o : iv, rows ? iv : o);
+            em_end(em);
+            em_store(em, 0, o, o);
+            break;
+        }
+        if (scope)
+            em_end(em);
+    }
+    if (olen > 1 && !em->unroll)
+        em_end(em);
+}
+
+/* Every block of an M x N transpose, in cfg's order */
+static void emit_blocks(emitter *em, int M, int N, const blocking *cfg)
+{
+    int rows_full = N - N % cfg->bh, cols_full = M - M % cfg->bw;
+    int rows_left = N % cfg->bh, cols_left = M % cfg->bw;
+    int diagonal = blocking_has_diagonal(M, N, cfg) && cfg->diag != DIAG_SAME;
+    int by_rows = cfg->block_order == BLOCK_ROWS;
+    const char *outer = by_rows ? "bi" : "bj", *inner = by_rows ? "bj" : "bi";
+    int outer_full = by_rows ? rows_full : cols_full, inner_full = by_rows ? cols_full : rows_full;
+    int outer_step = by_rows ? cfg->bh : cfg->bw, inner_step = by_rows ? cfg->bw : cfg->bh;
+    char lo[EXPR_LEN], hi[EXPR_LEN], rf[EXPR_LEN], cf[EXPR_LEN];
+
+    snprintf(rf, sizeof(rf), "%d", rows_full);
+    snprintf(cf, sizeof(cf), "%d", cols_full);
+
+    if (rows_full > 0 && cols_full > 0) {
+        snprintf(hi, sizeof(hi), "%d", outer_full);
+        em_for(em, outer, "0", hi, outer_step);
+        snprintf(hi, sizeof(hi), "%d", inner_full);
+        if (diagonal) {
+            /* Blocks before the diagonal, the diagonal block, then the blocks after it */
+            em_for(em, inner, "0", outer, inner_step);
+            emit_block(em, cfg, "bi", "bj", cfg->bh, cfg->bw, 0);
+            em_end(em);
+            emit_block(em, cfg, outer, outer, cfg->bh, cfg->bw, 1);
+            em_for(em, inner, expr(lo, outer, outer_step), hi, inner_step);
+            emit_block(em, cfg, "bi", "bj", cfg->bh, cfg->bw, 0);
+            em_end(em);
+        } else {
+            em_for(em, inner, "0", hi, inner_step);
+            emit_block(em, cfg, "bi", "bj", cfg->bh, cfg->bw, 0);
+            em_end(em);
+        }
+        em_end(em);
+    }
+    if (cols_left > 0 && rows_full > 0) {
+        em_for(em, "bi", "0", rf, cfg->bh);
+        emit_block(em, cfg, "bi", cf, cfg->bh, cols_left, 0);
+        em_end(em);
+    }
+    if (rows_left > 0 && cols_full > 0) {
+        em_for(em, "bj", "0", cf, cfg->bw);
+        emit_block(em, cfg, rf, "bj", rows_left, cfg->bw, 0);
+        em_end(em);
+    }
+    if (rows_left > 0 && cols_left > 0)
+        emit_block(em, cfg, rf, cf, rows_left, cols_left, 0);
+}
+
+int blocking_has_diagonal(int M, int N, const blocking *cfg)
+{
+    return M == N && cfg->bh == cfg->bw && cfg->bh > 1 && N >= cfg->bh;
+}
+
+int blocking_valid(int M, int N, const blocking *cfg)
+{
+    int len = cfg->inner_order == INNER_ROWS ? cfg->bw : cfg->bh;
+
+    if (cfg->bh < 1 || cfg->bw < 1 || cfg->bh > N || cfg->bw > M)
+        return 0;
+    if ((cfg->copy == COPY_BUFFER || cfg->diag == DIAG_BUFFER) && len > BLOCKING_MAX_BUFFER)
+        return 0;
+    return cfg->diag == DIAG_SAME || blocking_has_diagonal(M, N, cfg);
+}
+
+static const char *block_order_names[] = {"rows", "cols"};
+static const char *inner_order_names[] = {"rows", "cols"};
+static const char *copy_names[] = {"direct", "buffer"};
+static const char *diag_names[] = {"same", "defer", "buffer"};
+
+void blocking_describe(const blocking *cfg, char *buf, size_t len)
+{
+    snprintf(buf, len, "bh=%d,bw=%d,order=%s,inner=%s,copy=%s,diag=%s", cfg->bh, cfg->bw,
+             block_order_names[cfg->block_order], inner_order_names[cfg->inner_order],
+             copy_names[cfg->copy], diag_names[cfg->diag]);
+}
+
+static int lookup(const char *value, const char **names, int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (strcmp(value, names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+int blocking_parse(const char *text, blocking *cfg)
+{
+    char order[16], inner[16], copy[16], diag[16];
+    int o, i, c, d;
+
+    if (sscanf(text, "bh=%d,bw=%d,order=%15[a-z],inner=%15[a-z],copy=%15[a-z],diag=%15[a-z]",
+               &cfg->bh, &cfg->bw, order, inner, copy, diag) != 6)
+        return -1;
+    if ((o = lookup(order, block_order_names, 2)) < 0 || (i = lookup(inner, inner_order_names, 2)) < 0 ||
+        (c = lookup(copy, copy_names, 2)) < 0 || (d = lookup(diag, diag_names, 3)) < 0)
+        return -1;
+    cfg->block_order = o;
+    cfg->inner_order = i;
+    cfg->copy = c;
+    cfg->diag = d;
+    return 0;
+}
+
+char *blocking_loopnest(int M, int N, const blocking *cfg, unsigned long long abase, unsigned long long bbase)
+{
+    char *text = NULL;
+    size_t len = 0;
+    emitter em = {0};
+
+    if ((em.out = open_memstream(&text, &len)) == NULL)
+        return NULL;
+    fprintf(em.out, "array A %#llx 4 %d\n", abase, M);
+    fprintf(em.out, "array B %#llx 4 %d\n", bbase, N);
+    emit_blocks(&em, M, N, cfg);
+    fclose(em.out);
+    return text;
+}
+
+void blocking_emit_c(FILE *out, const char *name, int M, int N, const blocking *cfg, int unroll)
+{
+    emitter em = {out, 1, 1, unroll};
+
+    fprintf(out, "void %s(int M, int N, int A[N][M], int B[M][N])\n{\n", name);
+    fprintf(out, "    if (M != %d || N != %d) {\n", M, N);
+    fprintf(out, "        correctTrans(M, N, A, B);\n");
+    fprintf(out, "        return;\n");
+    fprintf(out, "    }\n");
+    emit_blocks(&em, M, N, cfg);
+    fprintf(out, "}\n");
+}
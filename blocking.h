@@ -0,0 +1,63 @@
+/*
+ * blocking.h - One configuration of a blocked transpose B = A^T, written
+ *     out either as a loop-nest description (see loopnest.h) to simulate
+ *     or as a C kernel specialized for a fixed M and N.
+ *
+ * A is N rows by M columns. Blocks are bh rows by bw columns of A. The
+ * full blocks are walked first; the columns left over at the right and
+ * the rows left over at the bottom are then walked as one strip each,
+ * followed by the corner, so both outputs visit A and B in the same order.
+ */
+#ifndef BLOCKING_H
+#define BLOCKING_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* Most ints a buffered copy holds in locals (the lab allows 12 locals) */
+#define BLOCKING_MAX_BUFFER 8
+
+/* Which block loop is outermost */
+enum block_order {BLOCK_ROWS, BLOCK_COLS};
+
+/* Whether a block is walked along A's rows or along A's columns */
+enum inner_order {INNER_ROWS, INNER_COLS};
+
+/* How a block is copied: element by element, or a whole row (or column) of A into locals first */
+enum copy_strategy {COPY_DIRECT, COPY_BUFFER};
+
+/* How blocks on the diagonal of a square matrix are copied */
+enum diag_strategy {DIAG_SAME, DIAG_DEFER, DIAG_BUFFER};
+
+typedef struct blocking {
+    int bh, bw;
+    enum block_order block_order;
+    enum inner_order inner_order;
+    enum copy_strategy copy;
+    enum diag_strategy diag;
+} blocking;
+
+/* True if cfg can be used for an M x N transpose */
+int blocking_valid(int M, int N, const blocking *cfg);
+
+/* True if the matrix has diagonal blocks, so that cfg->diag matters */
+int blocking_has_diagonal(int M, int N, const blocking *cfg);
+
+/* Write cfg as "bh=8,bw=8,order=rows,inner=rows,copy=direct,diag=same" */
+void blocking_describe(const blocking *cfg, char *buf, size_t len);
+
+/* Parse the form written by blocking_describe. Returns -1 on error. */
+int blocking_parse(const char *text, blocking *cfg);
+
+/* The loop nest of cfg with A and B at the given addresses, in a malloc'd string */
+char *blocking_loopnest(int M, int N, const blocking *cfg, unsigned long long abase, unsigned long long bbase);
+
+/*
+ * blocking_emit_c - Write cfg as a transpose function called name, with
+ *     M and N folded into the loop bounds. With unroll, the loops inside
+ *     each block are unrolled completely. The function falls back to
+ *     correctTrans for any other size.
+ */
+void blocking_emit_c(FILE *out, const char *name, int M, int N, const blocking *cfg, int unroll);
+
+#endif /* BLOCKING_H */
@@ -6,9 +6,18 @@
 #include <assert.h>
 #include "cachelab.h"
 #include <time.h>
+#include <string.h>
 
-trans_func_t func_list[MAX_TRANS_FUNCS];
+trans_func_t* func_list = NULL;
 int func_counter = 0; 
+static int func_capacity = 0;
+
+/* Region markers: [id][0] is written on entry, [id][1] on exit */
+volatile char cl_region_markers[CL_MAX_REGIONS][2];
+static char cl_region_names[CL_MAX_REGIONS][CL_REGION_NAME_LEN];
+static int cl_region_count = 0;
+static int cl_region_stack[CL_MAX_REGIONS];
+static int cl_region_depth = 0;
 
 /* 
  * printSummary - Summarize the cache simulation statistics. Student cache simulators
@@ -66,6 +75,128 @@ void correctTrans(int M, int N, int A[N][M], int B[M][N])
 
 
 
+/* 
+ * cl_write_regions - Write the region table, one "id start end name" line
+ *     per region. Runs at exit so no file I/O lands inside a region.
+ */
+static void cl_write_regions(void)
+{
+    FILE* fp = fopen(CL_REGION_FILE, "w");
+    if (!fp)
+        return;
+    for (int i = 0; i < cl_region_count; i++) {
+        if (cl_region_names[i][0] == '\0')
+            continue;
+        fprintf(fp, "%d %llx %llx %s\n", i,
+                (unsigned long long) &cl_region_markers[i][0],
+                (unsigned long long) &cl_region_markers[i][1],
+                cl_region_names[i]);
+    }
+    fclose(fp);
+}
+
+/* 
+ * cl_region_set_name - Name region id, growing the table to hold it
+ */
+__attribute__((no_sanitize_thread))
+static void cl_region_set_name(int id, const char* name)
+{
+    assert(id >= 0 && id < CL_MAX_REGIONS);
+    if (cl_region_count == 0)
+        atexit(cl_write_regions);
+    strncpy(cl_region_names[id], name, CL_REGION_NAME_LEN - 1);
+    if (id >= cl_region_count)
+        cl_region_count = id + 1;
+}
+
+/* 
+ * cl_region_push/cl_region_pop - Region bookkeeping. When tracing with
+ *     tracegen-cap these are left uninstrumented, so that only the marker
+ *     writes themselves reach the trace and the table lookups do not
+ *     disturb the cache being measured. valgrind sees them all the same.
+ */
+__attribute__((no_sanitize_thread))
+static int cl_region_push(const char* name)
+{
+    int id;
+
+    for (id = 0; id < cl_region_count; id++) {
+        if (strcmp(cl_region_names[id], name) == 0)
+            break;
+    }
+    if (id == cl_region_count)
+        cl_region_set_name(id, name);
+
+    assert(cl_region_depth < CL_MAX_REGIONS);
+    cl_region_stack[cl_region_depth++] = id;
+    return id;
+}
+
+__attribute__((no_sanitize_thread))
+static int cl_region_pop(void)
+{
+    assert(cl_region_depth > 0);
+    return cl_region_stack[--cl_region_depth];
+}
+
+/* 
+ * cl_region_begin - Enter the region called name
+ */
+void cl_region_begin(const char* name)
+{
+    int id = cl_region_push(name);
+
+    /* First access counted in the region */
+    cl_region_markers[id][0] = 1;
+}
+
+/* 
+ * cl_region_end - Leave the innermost open region
+ */
+void cl_region_end(void)
+{
+    int id = cl_region_pop();
+
+    /* Last access counted in the region */
+    cl_region_markers[id][1] = 1;
+}
+
+/* 
+ * cl_region_name - Name region id. Call it outside any traced window.
+ */
+void cl_region_name(int id, const char* name)
+{
+    cl_region_set_name(id, name);
+}
+
+/* 
+ * cl_region_enter/cl_region_leave - Enter or leave region id, writing
+ *     nothing but its marker
+ */
+void cl_region_enter(int id)
+{
+    cl_region_markers[id][0] = 1;
+}
+
+void cl_region_leave(int id)
+{
+    cl_region_markers[id][1] = 1;
+}
+
+/* 
+ * cl_strdup - Copy a metadata string, which may be NULL
+ */
+static char* cl_strdup(const char* str)
+{
+    char* copy;
+
+    if (str == NULL)
+        return NULL;
+    copy = malloc(strlen(str) + 1);
+    assert(copy);
+    return strcpy(copy, str);
+}
+
 /* 
  * registerTransFunction - Add the given trans function into your list
  *     of functions to be tested
@@ -73,11 +204,82 @@ void correctTrans(int M, int N, int A[N][M], int B[M][N])
 void registerTransFunction(void (*trans)(int M, int N, int[N][M], int[M][N]), 
                            char* desc)
 {
+    registerTransFunctionInfo(trans, desc, NULL, NULL, 0);
+}
+
+/* 
+ * registerTransFunctionInfo - Add the given trans function, along with
+ *     its parameters, tags and whether it was generated. The list grows
+ *     as needed.
+ */
+int registerTransFunctionInfo(void (*trans)(int M, int N, int[N][M], int[M][N]), 
+                              char* desc, const char* params, const char* tags,
+                              int generated)
+{
+    if (func_counter == func_capacity) {
+        func_capacity = func_capacity ? 2 * func_capacity : 64;
+        func_list = realloc(func_list, func_capacity * sizeof(trans_func_t));
+        assert(func_list);
+    }
+
     func_list[func_counter].func_ptr = trans;
+    func_list[func_counter].inplace_ptr = NULL;
     func_list[func_counter].description = desc;
     func_list[func_counter].correct = 0;
     func_list[func_counter].num_hits = 0;
     func_list[func_counter].num_misses = 0;
     func_list[func_counter].num_evictions =0;
-    func_counter++;
+    func_list[func_counter].params = cl_strdup(params);
+    func_list[func_counter].tags = cl_strdup(tags);
+    func_list[func_counter].generated = generated;
+    return func_counter++;
+}
+
+/*
+ * registerInPlaceFunctionInfo - Add the given in-place function, tagged
+ *     "inplace" in front of any tags of its own
+ */
+int registerInPlaceFunctionInfo(void (*trans)(int M, int N, int[N][M]),
+                                char* desc, const char* params, const char* tags)
+{
+    char all_tags[256];
+    int i;
+
+    snprintf(all_tags, sizeof(all_tags), "inplace%s%s", tags ? "," : "", tags ? tags : "");
+    i = registerTransFunctionInfo(NULL, desc, params, all_tags, 0);
+    func_list[i].inplace_ptr = trans;
+    return i;
+}
+
+/* 
+ * transFunctionHasTag - True if tag is one of entry i's comma separated tags
+ */
+int transFunctionHasTag(int i, const char* tag)
+{
+    const char* t = func_list[i].tags;
+    size_t len = strlen(tag);
+
+    while (t != NULL && *t) {
+        size_t n = strcspn(t, ",");
+        if (n == len && strncmp(t, tag, len) == 0)
+            return 1;
+        t += n;
+        if (*t == ',')
+            t++;
+    }
+    return 0;
+}
+
+/* 
+ * transFunctionFitsSize - Generated kernels are tagged "<M>x<N>" with the
+ *     one size they handle; every other function fits any size
+ */
+int transFunctionFitsSize(int i, int M, int N)
+{
+    char size[32];
+
+    if (!func_list[i].generated)
+        return 1;
+    sprintf(size, "%dx%d", M, N);
+    return transFunctionHasTag(i, size);
 }
@@ -5,15 +5,25 @@
 #ifndef CACHELAB_TOOLS_H
 #define CACHELAB_TOOLS_H
 
-#define MAX_TRANS_FUNCS 100
+/* Named trace regions (see cl_region_begin) */
+#define CL_MAX_REGIONS 64
+#define CL_REGION_NAME_LEN 64
+#define CL_REGION_FILE ".regions"
+
+/* Distance between the marker pairs of consecutive functions (see tracegen.c) */
+#define MARKER_STRIDE 4096
 
 typedef struct trans_func{
-  void (*func_ptr)(int M,int N,int[N][M],int[M][N]);
+  void (*func_ptr)(int M,int N,int[N][M],int[M][N]);   /* NULL for an in-place function */
+  void (*inplace_ptr)(int M,int N,int[N][M]);          /* set only for an in-place function */
   char* description;
   char correct;
   unsigned int num_hits;
   unsigned int num_misses;
   unsigned int num_evictions;
+  char* params;   /* parameters of the variant, e.g. "bsize=8,unroll=4", or NULL */
+  char* tags;     /* comma separated tags, or NULL */
+  int generated;  /* registered by generated code rather than by hand */
 } trans_func_t;
 
 /* 
@@ -34,4 +44,52 @@ void correctTrans(int M, int N, int A[N][M], int B[M][N]);
 void registerTransFunction(
     void (*trans)(int M,int N,int[N][M],int[M][N]), char* desc);
 
+/* Add the given function with its parameters and tags (either may be
+   NULL), and return its index in the function list */
+int registerTransFunctionInfo(
+    void (*trans)(int M,int N,int[N][M],int[M][N]), char* desc,
+    const char* params, const char* tags, int generated);
+
+/* Add an in-place transpose: it is given only A, N rows by M columns,
+   and must leave A^T, M rows by N columns, in the same memory. It is
+   tagged "inplace" besides the given tags, and its index is returned. */
+int registerInPlaceFunctionInfo(
+    void (*trans)(int M,int N,int[N][M]), char* desc,
+    const char* params, const char* tags);
+
+/* Registers the kernels kernelgen wrote to trans-gen.c, when that is
+   linked in (make GEN=<spec>); otherwise the symbol is null */
+void registerGeneratedFunctions(void) __attribute__((weak));
+
+/* True if func_list entry i has the given tag */
+int transFunctionHasTag(int i, const char* tag);
+
+/* False for a generated kernel specialized for a size other than M x N,
+   which would only run its correctTrans fallback */
+int transFunctionFitsSize(int i, int M, int N);
+
+/* 
+ * cl_region_begin/cl_region_end - Bracket a named region of code so that
+ *     its memory accesses can be told apart in a trace. Every name gets
+ *     its own pair of marker addresses, which are written on entry and
+ *     exit. Regions may nest. The table of names and markers is written
+ *     to CL_REGION_FILE when the program exits, and csim -R or test-trans
+ *     use it to report hits, misses and evictions per region.
+ */
+void cl_region_begin(const char* name);
+void cl_region_end(void);
+
+/* 
+ * cl_region_name/cl_region_enter/cl_region_leave - The same by number.
+ *     cl_region_begin looks its name up and cl_region_end pops a stack,
+ *     and valgrind traces those loads along with the region's enclosing
+ *     windows. Name the region once, outside the function being traced
+ *     (registerFunctions is a good place), and bracket the code with
+ *     cl_region_enter(id) and cl_region_leave(id) with a constant id:
+ *     then only the marker writes are traced, with either tracer.
+ */
+void cl_region_name(int id, const char* name);
+void cl_region_enter(int id);
+void cl_region_leave(int id);
+
 #endif /* CACHELAB_TOOLS_H */
@@ -0,0 +1,328 @@
+/*
+ * csim-online.c - Concurrent front end for the csim engine.
+ *
+ * Each producer owns one single-producer/single-consumer ring per shard.
+ * The producer only ever writes a ring's tail and the shard's simulator
+ * thread only ever writes its head, so pushing an access is a plain store
+ * plus one release store, with no locks and no shared counters between
+ * producers. A shard owns every set whose index is congruent to it modulo
+ * the number of shards, so the shards never touch the same set and need
+ * no locks between them either.
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include "csim-online.h"
+
+/* Ring capacity per producer and shard (power of two) */
+#define RING_SIZE 4096
+#define RING_MASK (RING_SIZE - 1)
+
+/* Accesses consumed from one ring before moving on to the next */
+#define DRAIN_BATCH 256
+
+#define load_acquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+typedef struct online_event {
+    unsigned long long address;
+    unsigned long long timestamp;
+    char type;
+} online_event;
+
+typedef struct online_ring {
+    /* Written by the shard's simulator thread only */
+    unsigned long long head __attribute__((aligned(64)));
+    /* Written by the producer only */
+    unsigned long long tail __attribute__((aligned(64)));
+    online_event ring[RING_SIZE] __attribute__((aligned(64)));
+} online_ring;
+
+struct csim_producer {
+    csim_online *online;
+    int detached;
+    int id;
+    /* Timestamp of the last access pushed to any shard (deterministic mode) */
+    unsigned long long watermark __attribute__((aligned(64)));
+    online_ring rings[];
+};
+
+/* One simulator thread and the counters for the sets it owns */
+typedef struct online_shard {
+    csim_online *online;
+    int index;
+    cache_performance perf;
+    location loc;
+    pthread_t thread;
+} online_shard;
+
+struct csim_online {
+    cache *sim_cache;
+    int sbits;
+    int bbits;
+    int num_shards;
+    int deterministic;
+    int expected_producers;
+    int num_producers;
+    int finishing;
+    pthread_mutex_t attach_lock;
+    csim_producer *producers[CSIM_ONLINE_MAX_PRODUCERS];
+    online_shard shards[CSIM_ONLINE_MAX_SHARDS];
+};
+
+/*
+ * ring_done - True once a producer has detached and its ring is empty.
+ *     detached is read before tail so that a push that happened before
+ *     the detach is always seen.
+ */
+static int ring_done(csim_producer *p, online_ring *r)
+{
+    if (!load_acquire(&p->detached))
+        return 0;
+    return r->head == load_acquire(&r->tail);
+}
+
+/*
+ * drain_arrival_order - Simulate whatever each of the shard's rings
+ *     currently holds, visiting them round robin. Returns the number of
+ *     accesses simulated, and sets *all_done if every producer is finished.
+ */
+static int drain_arrival_order(online_shard *shard, int *all_done)
+{
+    csim_online *online = shard->online;
+    int n = load_acquire(&online->num_producers);
+    int work = 0;
+
+    *all_done = 1;
+    for (int i = 0; i < n; i++) {
+        csim_producer *p = online->producers[i];
+        online_ring *r = &p->rings[shard->index];
+        int detached = load_acquire(&p->detached);
+        unsigned long long tail = load_acquire(&r->tail);
+        unsigned long long head = r->head;
+
+        for (int k = 0; k < DRAIN_BATCH && head != tail; k++, head++) {
+            online_event *ev = &r->ring[head & RING_MASK];
+            simulate_access(&shard->perf, online->sim_cache, &shard->loc, ev->type, ev->address);
+            work++;
+        }
+        store_release(&r->head, head);
+
+        if (!detached || head != tail)
+            *all_done = 0;
+    }
+    return work;
+}
+
+/* key_before - True if (ts, id) comes before (ts2, id2) in the merge */
+static int key_before(unsigned long long ts, int id, unsigned long long ts2, int id2)
+{
+    return ts < ts2 || (ts == ts2 && id < id2);
+}
+
+/*
+ * drain_deterministic - Merge the shard's rings by (timestamp, producer
+ *     id). A producer with nothing queued for this shard may still send
+ *     it any timestamp from its watermark on, so it bounds the merge at
+ *     (watermark, id); one with something queued bounds it at its first
+ *     access. The smallest ring is drained for as long as it stays ahead
+ *     of every other bound. Restricted to the shard's sets this is the
+ *     same order a single merge of all rings would give, so the results
+ *     don't depend on the number of shards.
+ */
+static int drain_deterministic(online_shard *shard, int *all_done)
+{
+    csim_online *online = shard->online;
+    int n = load_acquire(&online->num_producers);
+    csim_producer *best = NULL;
+    unsigned long long best_ts = 0, bound_ts = 0;
+    int bound_id = -1;
+
+    *all_done = 0;
+    if (n < online->expected_producers)
+        return 0;
+
+    for (int i = 0; i < n; i++) {
+        csim_producer *p = online->producers[i];
+        online_ring *r = &p->rings[shard->index];
+        /* Read before the ring: every later push has a timestamp of at least this */
+        unsigned long long watermark = load_acquire(&p->watermark);
+        unsigned long long ts;
+
+        if (r->head == load_acquire(&r->tail)) {
+            if (ring_done(p, r))
+                continue;
+            ts = watermark;
+        } else {
+            ts = r->ring[r->head & RING_MASK].timestamp;
+            if (best == NULL || key_before(ts, p->id, best_ts, best->id)) {
+                if (best != NULL && (bound_id == -1 || key_before(best_ts, best->id, bound_ts, bound_id))) {
+                    bound_ts = best_ts;
+                    bound_id = best->id;
+                }
+                best = p;
+                best_ts = ts;
+                continue;
+            }
+        }
+        if (bound_id == -1 || key_before(ts, p->id, bound_ts, bound_id)) {
+            bound_ts = ts;
+            bound_id = p->id;
+        }
+    }
+
+    if (best == NULL) {
+        *all_done = bound_id == -1;
+        return 0;
+    }
+
+    int work = 0;
+    online_ring *r = &best->rings[shard->index];
+    unsigned long long tail = load_acquire(&r->tail);
+    unsigned long long head = r->head;
+    while (head != tail && work < DRAIN_BATCH) {
+        online_event *ev = &r->ring[head & RING_MASK];
+        if (bound_id != -1 && !key_before(ev->timestamp, best->id, bound_ts, bound_id))
+            break;
+        simulate_access(&shard->perf, online->sim_cache, &shard->loc, ev->type, ev->address);
+        head++;
+        work++;
+    }
+    store_release(&r->head, head);
+    return work;
+}
+
+/*
+ * simulator_thread - Drain one shard's rings until finish has been
+ *     requested and every producer is done.
+ */
+static void *simulator_thread(void *arg)
+{
+    online_shard *shard = arg;
+    csim_online *online = shard->online;
+
+    for (;;) {
+        int all_done;
+        int work = online->deterministic ? drain_deterministic(shard, &all_done)
+                                         : drain_arrival_order(shard, &all_done);
+        if (work == 0) {
+            if (all_done && load_acquire(&online->finishing))
+                break;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+csim_online *csim_online_create(int sbits, int lines_per_set, int bytes_per_line,
+                                int deterministic, int expected_producers, int shards)
+{
+    csim_online *online = calloc(1, sizeof(csim_online));
+    if (online == NULL)
+        return NULL;
+
+    if (shards <= 0)
+        shards = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (shards > CSIM_ONLINE_MAX_SHARDS)
+        shards = CSIM_ONLINE_MAX_SHARDS;
+    if (sbits < 31 && shards > (1 << sbits))
+        shards = 1 << sbits;
+    if (shards < 1)
+        shards = 1;
+
+    setup_cache(&online->sim_cache, sbits, lines_per_set, bytes_per_line,
+                64 - (sbits + bytes_per_line));
+    online->sbits = sbits;
+    online->bbits = bytes_per_line;
+    online->num_shards = shards;
+    online->deterministic = deterministic;
+    online->expected_producers = deterministic ? expected_producers : 0;
+    pthread_mutex_init(&online->attach_lock, NULL);
+
+    for (int k = 0; k < shards; k++) {
+        online->shards[k].online = online;
+        online->shards[k].index = k;
+        if (pthread_create(&online->shards[k].thread, NULL, simulator_thread, &online->shards[k]) != 0) {
+            /* Let the shards already started finish with nothing to do */
+            store_release(&online->finishing, 1);
+            for (int j = 0; j < k; j++)
+                pthread_join(online->shards[j].thread, NULL);
+            pthread_mutex_destroy(&online->attach_lock);
+            free_cache(&online->sim_cache);
+            free(online);
+            return NULL;
+        }
+    }
+    return online;
+}
+
+csim_producer *csim_online_attach(csim_online *online, int id)
+{
+    csim_producer *p = NULL;
+    size_t size = sizeof(csim_producer) + online->num_shards * sizeof(online_ring);
+
+    pthread_mutex_lock(&online->attach_lock);
+    int n = online->num_producers;
+    for (int i = 0; i < n; i++) {
+        if (online->producers[i]->id == id) {
+            pthread_mutex_unlock(&online->attach_lock);
+            return NULL;
+        }
+    }
+    if (n < CSIM_ONLINE_MAX_PRODUCERS && posix_memalign((void **) &p, 64, size) == 0) {
+        memset(p, 0, size);
+        p->online = online;
+        p->id = id;
+        online->producers[n] = p;
+        /* Publish the slot only after it is fully initialized */
+        store_release(&online->num_producers, n + 1);
+    }
+    pthread_mutex_unlock(&online->attach_lock);
+    return p;
+}
+
+void csim_online_access(csim_producer *p, char type,
+                        unsigned long long address, unsigned long long timestamp)
+{
+    csim_online *online = p->online;
+    unsigned long long set = (address >> online->bbits) & ((1ULL << online->sbits) - 1);
+    online_ring *r = &p->rings[set % online->num_shards];
+    unsigned long long tail = r->tail;
+
+    while (tail - load_acquire(&r->head) >= RING_SIZE)
+        sched_yield();
+
+    online_event *ev = &r->ring[tail & RING_MASK];
+    ev->address = address;
+    ev->timestamp = timestamp;
+    ev->type = type;
+    store_release(&r->tail, tail + 1);
+    if (online->deterministic)
+        store_release(&p->watermark, timestamp);
+}
+
+void csim_online_detach(csim_producer *p)
+{
+    store_release(&p->detached, 1);
+}
+
+void csim_online_finish(csim_online *online, cache_performance *cp)
+{
+    store_release(&online->finishing, 1);
+    memset(cp, 0, sizeof(*cp));
+    for (int k = 0; k < online->num_shards; k++) {
+        pthread_join(online->shards[k].thread, NULL);
+        cp->hits += online->shards[k].perf.hits;
+        cp->misses += online->shards[k].perf.misses;
+        cp->evictions += online->shards[k].perf.evictions;
+    }
+
+    for (int i = 0; i < online->num_producers; i++)
+        free(online->producers[i]);
+    pthread_mutex_destroy(&online->attach_lock);
+    free_cache(&online->sim_cache);
+    free(online);
+}
@@ -0,0 +1,67 @@
+/*
+ * csim-online.h - Concurrent front end that feeds accesses from many
+ *     threads of an instrumented program into one simulated shared cache.
+ *
+ * Every producing thread attaches once and gets its own lock-free
+ * single-producer rings. The sets of the cache are striped over shards
+ * (set index modulo the number of shards), each simulated by its own
+ * thread, and a producer pushes every access into its ring for the
+ * shard that owns the access's set. Producers never contend with each
+ * other or with the simulation, and since no two shards share a set,
+ * throughput grows with the number of shards up to the number of cores.
+ *
+ * In the default mode accesses are simulated in arrival order. In
+ * deterministic mode every access carries a logical timestamp and the
+ * simulator merges the rings by (timestamp, producer id), which gives the
+ * same results on every run, and for any number of shards, as long as
+ * each producer's timestamps never decrease and each producer attaches
+ * with the same id on every run.
+ */
+
+#ifndef CSIM_ONLINE_H
+#define CSIM_ONLINE_H
+
+#include "csim.h"
+
+/* Maximum number of producer threads attached to one simulated cache */
+#define CSIM_ONLINE_MAX_PRODUCERS 64
+
+/* Maximum number of simulator threads (shards) for one simulated cache */
+#define CSIM_ONLINE_MAX_SHARDS 16
+
+typedef struct csim_online csim_online;
+typedef struct csim_producer csim_producer;
+
+/*
+ * csim_online_create - Set up a shared (s, E, b) cache and start one
+ *     simulator thread per shard; shards <= 0 means one per online CPU,
+ *     and there are never more shards than sets. In deterministic mode
+ *     the simulators wait until expected_producers threads have attached
+ *     before consuming anything.
+ */
+csim_online *csim_online_create(int sbits, int lines_per_set, int bytes_per_line,
+                                int deterministic, int expected_producers, int shards);
+
+/*
+ * csim_online_attach - Register the calling thread as producer id, which
+ *     breaks timestamp ties in deterministic mode. Give every producer a
+ *     distinct id that doesn't depend on scheduling, e.g. its thread's
+ *     index. Returns NULL if the cache is full or id is taken.
+ */
+csim_producer *csim_online_attach(csim_online *online, int id);
+
+/* Queue one access ('L', 'S' or 'M'). Spins while the ring is full. */
+void csim_online_access(csim_producer *producer, char type,
+                        unsigned long long address, unsigned long long timestamp);
+
+/* Mark the producer as done; its remaining accesses are still simulated */
+void csim_online_detach(csim_producer *producer);
+
+/*
+ * csim_online_finish - Wait until every attached producer has detached
+ *     and every ring is drained, store the totals in cp, and free
+ *     everything.
+ */
+void csim_online_finish(csim_online *online, cache_performance *cp);
+
+#endif /* CSIM_ONLINE_H */
@@ -0,0 +1,53 @@
+/*
+Cachelab -- CS 2011
+csim-probe.h - Static probe points on the simulator hot path.
+
+Probes compile to nothing unless csim is built with -DCSIM_PROBES (make PROBES=1). When enabled, every probe bumps a
+counter and the timed sections accumulate TSC cycles; csim prints the totals to stderr when it exits. Adding
+-DCSIM_USDT (make USDT=1, needs <sys/sdt.h>) also emits a USDT marker per probe, so perf, bpftrace or SystemTap can
+attach to csim:lookup, csim:hit, csim:fill, csim:evict and csim:policy with the set id and tag as arguments.
+*/
+
+#ifndef CSIM_PROBE_H
+#define CSIM_PROBE_H
+
+#include <stdio.h>
+
+//Probe points, in the order they are reported
+enum ProbeId {PROBE_LOOKUP, PROBE_HIT, PROBE_FILL, PROBE_EVICT, PROBE_POLICY, NUM_PROBES};
+
+#ifdef CSIM_PROBES
+
+#include <x86intrin.h>
+
+#ifdef CSIM_USDT
+#include <sys/sdt.h>
+#define CSIM_USDT_PROBE(name, set_id, tag_id) DTRACE_PROBE2(csim, name, set_id, tag_id)
+#else
+#define CSIM_USDT_PROBE(name, set_id, tag_id) ((void) 0)
+#endif
+
+//Defined in csim.c
+extern unsigned long long probe_counts[NUM_PROBES];
+extern unsigned long long probe_cycles[NUM_PROBES];
+void probe_report(FILE *out);
+
+//Count one firing of a probe, e.g. CSIM_PROBE(hit, HIT, set_id, tag_id)
+#define CSIM_PROBE(name, id, set_id, tag_id) do { \
+        probe_counts[PROBE_##id]++; \
+        CSIM_USDT_PROBE(name, set_id, tag_id); \
+    } while(0)
+
+//Start a timed section, then charge its cycles to a probe
+#define CSIM_PROBE_TIMER(var) unsigned long long var = __rdtsc()
+#define CSIM_PROBE_ELAPSED(id, var) (probe_cycles[PROBE_##id] += __rdtsc() - (var))
+
+#else
+
+#define CSIM_PROBE(name, id, set_id, tag_id) ((void) 0)
+#define CSIM_PROBE_TIMER(var) ((void) 0)
+#define CSIM_PROBE_ELAPSED(id, var) ((void) 0)
+
+#endif /* CSIM_PROBES */
+
+#endif /* CSIM_PROBE_H */
@@ -5,108 +5,148 @@ Eli Benevedes - eabenevedes@wpi.edu
 Patrick Eaton - pweaton@wpi.edu
 */
 
+#define _GNU_SOURCE
 #include "cachelab.h"
+#include "csim.h"
+#include "csim-probe.h"
 #include <unistd.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <getopt.h>
 #include <math.h>
+#include <string.h>
+#include <immintrin.h>
+#include <stdint.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <errno.h>
 
-/**
- * Struct representing a location of data within the cache
- * @param set_id index of the set
- * @param tag_id tag of the line
- */
-typedef struct location {
-    int set_id;
-    unsigned long long tag_id;
-} location;
+//Maximum number of direct-mapped geometries simulated side by side by the -D sweep
+#define DM_MAX_LANES 16
 
-//Enum representing a cache hit, cold miss, or miss
-enum HitOrMiss {HIT, COLD_MISS, MISS};
+//Lanes per 256-bit vector of 32-bit tags
+#define DM_VECTOR_LANES 8
 
-//Forward declare print_usage and get_and_set_tag
-void print_usage();
-void get_set_and_tag(location *loc, unsigned long long address, int tbits, int sbits);
+//Number of trace accesses buffered before they are handed to the lane engine
+#define DM_BATCH 4096
 
-/**
- * Struct to store the performance of the cache.
- * @param hits number of cache hits
- * @param misses number of cache misses
- * @param evictions number of cache evictions
- */
-typedef struct cache_performance {
-    int hits;
-    int misses;
-    int evictions;
-} cache_performance;
+//Checkpoint file identification. Bump the version whenever the layout below changes.
+#define CHECKPOINT_MAGIC "CSIMCKPT"
+#define CHECKPOINT_VERSION 1
+#define DEFAULT_CHECKPOINT_PATH ".csim_checkpoint"
 
-//Forward declare the simulate_cache function
-void simulate_cache();
+//Maximum number of suffix traces that can continue from one warmed-up prefix
+#define MAX_FORKS 64
 
-/**
- * Struct representing a single line within a set in a cache
- * @param valid whether or not this line is caching data. 0 if the cache hasn't been fully warmed up
- * @param tag number representing the tag for this cache line
- */
-typedef struct line {
-    bool valid;
-    unsigned long long tag; //ensure 64-bit address compatibility
-} line;
+//Long-only command line options
+enum LongOption {OPT_CHECKPOINT_EVERY = 256, OPT_CHECKPOINT_FILE, OPT_RESTORE, OPT_FORK};
+
+//Forward declare print_usage and the cache internals not exposed through csim.h
+void print_usage();
+void allocate_cache(cache **sim_cache);
+void allocate_lru_tracker(cache **sim_cache);
+void LRU_hit(cache *sim_cache, int set_id, unsigned long long tag_id, int z);
+void LRU_cold(cache *sim_cache, int set_id, unsigned long long tag_id);
+void LRU_miss(cache *sim_cache, int set_id, unsigned long long tag_id);
 
 /**
- * Struct representing a single set in the simulated cache
- * @param id index of the set in the cache's set array
- * @param lines list of lines within each specific set
+ * Struct holding up to DM_MAX_LANES direct-mapped caches that are simulated side by side, one per lane. Each lane
+ * has its own set shift and mask and its own slice of the shared tag array, so a single access updates every lane
+ * with one gather and one compare. Lane counts are padded to a multiple of DM_VECTOR_LANES with 1-set dummy lanes.
+ * @param lanes number of real geometries requested
+ * @param padded_lanes lanes rounded up to a whole number of vectors
+ * @param bbits shift that drops the block offset (b) for each lane
+ * @param tshift shift that drops the block offset and set index (s + b) for each lane
+ * @param set_mask 2^s - 1 for each lane
+ * @param base index of each lane's first set within tags
+ * @param tags tag of every line of every lane, stored as tag + 1 so that 0 marks an invalid line
+ * @param hits number of cache hits per lane
+ * @param misses number of cache misses per lane
+ * @param evictions number of cache evictions per lane
  */
-typedef struct set {
-    int id;
-    line *lines;
-} set;
+typedef struct dm_lanes {
+    int lanes;
+    int padded_lanes;
+    unsigned int bbits[DM_MAX_LANES];
+    unsigned int tshift[DM_MAX_LANES];
+    unsigned int set_mask[DM_MAX_LANES];
+    unsigned int base[DM_MAX_LANES];
+    unsigned int *tags;
+    int hits[DM_MAX_LANES];
+    int misses[DM_MAX_LANES];
+    int evictions[DM_MAX_LANES];
+} dm_lanes;
 
 /**
- * Struct for a node in the linked lists managing the LRU eviction policy. Declared before the cache so that it knows
- * the type lru_node.
- * @param prev previous node in the LL
- * @param next subsequent node in the LL
- * @param idx index into the lines array for the set the linked list is responsible for
+ * Header at the start of a checkpoint file. Every field has a fixed width and the arrays that follow are at fixed
+ * offsets, so a checkpoint can be mmapped and read in place without any parsing.
+ * @param magic CHECKPOINT_MAGIC, without a terminator
+ * @param version CHECKPOINT_VERSION of the writer
+ * @param header_size sizeof(checkpoint_header) of the writer
+ * @param sbits, lines_per_set, bytes_per_line geometry of the saved cache
+ * @param hits, misses, evictions counters at the time of the checkpoint
+ * @param accesses number of trace lines consumed so far
+ * @param trace_offset byte offset in the trace file where the simulation resumes
+ * @param lines_offset byte offset of the checkpoint_line array (2^s * E entries, set major)
+ * @param lru_offset byte offset of the LRU order array (2^s * E line indices per set, most recently used first)
+ * @param file_size total size of the checkpoint in bytes
  */
-typedef struct lru_node {
-    struct lru_node *prev;
-    struct lru_node *next;
-    int idx; //Index into the array of lines in the set
-} lru_node;
+typedef struct checkpoint_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    int32_t sbits;
+    int32_t lines_per_set;
+    int32_t bytes_per_line;
+    int32_t reserved;
+    int64_t hits;
+    int64_t misses;
+    int64_t evictions;
+    uint64_t accesses;
+    uint64_t trace_offset;
+    uint64_t lines_offset;
+    uint64_t lru_offset;
+    uint64_t file_size;
+} checkpoint_header;
 
 /**
- * Struct representing the cache to be simulated.
- * @param sets list of sets the cache will simulate (2^s)
- * @param lines_per_set how many lines there are per set (E)
- * @param bytes_per_line how many bytes each cache block will store (2^b)
- * @param sbits number of bits for the set id
- * @param tbits number of bits for the tag
- * @param verbose unused, was used for printing debugging information originally
+ * Struct for a single saved cache line inside a checkpoint file
+ * @param tag tag stored in the line
+ * @param valid 1 if the line holds data
  */
-typedef struct cache {
-    set *sets;
-    int lines_per_set;
-    int bytes_per_line;
-    int sbits;
-    int tbits;
-    bool verbose;
-    lru_node **lru_tracker;
-} cache;
-
-//Forward declare of functions requiring cache
-void setup_cache(cache **sim_cache, int sbits, int lines_per_set, int bytes_per_line, int tbits);
-void allocate_cache(cache **sim_cache);
-void allocate_lru_tracker(cache **sim_cache);
-void free_cache(cache **sim_cache);
-enum HitOrMiss cache_scan(struct location *loc, cache *sim_cache);
-void LRU_hit(cache *sim_cache, int set_id, unsigned long long tag_id, int z);
-void LRU_cold(cache *sim_cache, int set_id, unsigned long long tag_id);
-void LRU_miss(cache *sim_cache, int set_id, unsigned long long tag_id);
-
+typedef struct checkpoint_line {
+    uint64_t tag;
+    uint32_t valid;
+    uint32_t reserved;
+} checkpoint_line;
+
+//Forward declare the checkpoint functions
+int write_checkpoint(const char *path, cache_performance *cp, cache *sim_cache, unsigned long long accesses,
+                     long trace_offset);
+checkpoint_header *map_checkpoint(const char *path);
+int valid_lru_order(checkpoint_header *header);
+void apply_checkpoint(checkpoint_header *header, cache_performance *cp, cache *sim_cache);
+void unmap_checkpoint(checkpoint_header *header);
+void install_stop_handlers();
+void fork_suffixes(cache_performance *cp, cache *sim_cache, char **suffix_paths, int num_suffixes);
+
+//Set by the SIGINT and SIGALRM handlers, polled by simulate_cache between trace lines
+static volatile sig_atomic_t stop_requested = 0;
+
+//Forward declare the direct-mapped lane engine
+int parse_dm_geometries(char *list, int *sbits, int *bbits);
+void setup_dm_lanes(dm_lanes **dm, int lanes, int *sbits, int *bbits);
+void free_dm_lanes(dm_lanes **dm);
+void simulate_dm_lanes(dm_lanes *dm, FILE *trace_file);
+void dm_lanes_batch(dm_lanes *dm, const char *types, const unsigned int *addresses, int count);
+void dm_lanes_batch_scalar(dm_lanes *dm, const char *types, const unsigned int *addresses, int count);
+void dm_lanes_batch_avx2(dm_lanes *dm, const char *types, const unsigned int *addresses, int count);
+
+#ifndef CSIM_NO_MAIN
 /**
  * Called on startup.
  * @param argc number of command line arguments
@@ -122,18 +162,33 @@ int main(int argc, char *argv[])
     int lines_per_set = -1;
     int bytes_per_line = -1;
     char *trace_path = (char *) NULL;
+    char *dm_list = (char *) NULL;
+    char *restore_path = (char *) NULL;
+    char *region_path = (char *) NULL;
+    checkpoint_settings ckpt = {0, (char *) NULL, 0, 0};
+    char *suffix_paths[MAX_FORKS];
+    int num_suffixes = 0;
 
     FILE *trace_file;
 
-    //Allocate memory for the cache performance struct
-    cache_performance *cp = (cache_performance *) malloc(sizeof(cache_performance));
+    //Allocate memory for the cache performance struct, starting every counter at 0
+    cache_performance *cp = (cache_performance *) calloc(1, sizeof(cache_performance));
+
+    //Options that only have a long form
+    static struct option long_options[] = {
+        {"checkpoint-every", required_argument, NULL, OPT_CHECKPOINT_EVERY},
+        {"checkpoint-file", required_argument, NULL, OPT_CHECKPOINT_FILE},
+        {"restore", required_argument, NULL, OPT_RESTORE},
+        {"fork", required_argument, NULL, OPT_FORK},
+        {NULL, 0, NULL, 0}
+    };
 
     //Declare variables for the current command line argument, and p to pass into strtol
     int opt;
     char *p;
 
     //Loop through each command line argument, pull the data into the initialized variables
-    while((opt = getopt(argc, argv, "hvs:E:b:t:")) != -1) {
+    while((opt = getopt_long(argc, argv, "hvs:E:b:t:D:R:", long_options, NULL)) != -1) {
         switch(opt) {
             case 'h':
                 help_flag = true;
@@ -153,11 +208,87 @@ int main(int argc, char *argv[])
             case 't':
                 trace_path = optarg;
                 break;
+            case 'D':
+                dm_list = optarg;
+                break;
+            case 'R':
+                region_path = optarg;
+                break;
+            case OPT_CHECKPOINT_EVERY:
+                ckpt.every = strtoll(optarg, &p, 10);
+                break;
+            case OPT_CHECKPOINT_FILE:
+                ckpt.path = optarg;
+                break;
+            case OPT_RESTORE:
+                restore_path = optarg;
+                break;
+            case OPT_FORK:
+                if(num_suffixes == MAX_FORKS) {
+                    printf("At most %d --fork traces are supported.\n", MAX_FORKS);
+                    exit(0);
+                }
+                suffix_paths[num_suffixes++] = optarg;
+                break;
             default:
                 break;
         }
     }
 
+    //A direct-mapped sweep brings its own geometries, so it only needs the trace file
+    if(dm_list != (char *) NULL && trace_path != (char *) NULL && !help_flag) {
+        int dm_sbits[DM_MAX_LANES];
+        int dm_bbits[DM_MAX_LANES];
+        int lanes = parse_dm_geometries(dm_list, dm_sbits, dm_bbits);
+
+        if(lanes <= 0) {
+            printf("Invalid geometry list \"%s\". Expected up to %d comma separated s:b pairs with s + b >= 1.\n",
+                   dm_list, DM_MAX_LANES);
+            exit(0);
+        }
+
+        trace_file = fopen(trace_path, "r");
+        if(trace_file == NULL) {
+            printf("Invalid trace file path \"%s\".\n", trace_path);
+            exit(0);
+        }
+
+        dm_lanes *dm = NULL;
+        setup_dm_lanes(&dm, lanes, dm_sbits, dm_bbits);
+        simulate_dm_lanes(dm, trace_file);
+
+        for(int i = 0; i < lanes; i++) {
+            printf("(s=%d, E=1, b=%d) hits:%d misses:%d evictions:%d\n",
+                   dm_sbits[i], dm_bbits[i], dm->hits[i], dm->misses[i], dm->evictions[i]);
+        }
+
+        free_dm_lanes(&dm);
+        fclose(trace_file);
+        free(cp);
+        return 0;
+    }
+
+    //A restored checkpoint supplies the geometry, which has to agree with anything given on the command line
+    checkpoint_header *restored = NULL;
+    if(restore_path != (char *) NULL) {
+        restored = map_checkpoint(restore_path);
+        if(restored == NULL) {
+            printf("Invalid checkpoint file \"%s\".\n", restore_path);
+            exit(0);
+        }
+
+        if((s != -1 && s != restored->sbits) || (lines_per_set != -1 && lines_per_set != restored->lines_per_set) ||
+           (bytes_per_line != -1 && bytes_per_line != restored->bytes_per_line)) {
+            printf("Checkpoint \"%s\" was taken with s=%d E=%d b=%d.\n", restore_path, restored->sbits,
+                   restored->lines_per_set, restored->bytes_per_line);
+            exit(0);
+        }
+
+        s = restored->sbits;
+        lines_per_set = restored->lines_per_set;
+        bytes_per_line = restored->bytes_per_line;
+    }
+
     //If one of the required parameters was not given, so inform user how parameters work then quit
     if(s == -1 || lines_per_set == -1 || bytes_per_line == -1 || trace_path == (char *) NULL || help_flag) {
         print_usage();
@@ -180,19 +311,75 @@ int main(int argc, char *argv[])
     //Give the verbose flag to the cache to be accessed later
     simulated_cache->verbose = verbose_flag;
 
+    //Pick up where the checkpoint left off: cache contents, counters, and position in the trace
+    if(restored != NULL) {
+        apply_checkpoint(restored, cp, simulated_cache);
+        ckpt.accesses = restored->accesses;
+        fseek(trace_file, (long) restored->trace_offset, SEEK_SET);
+        unmap_checkpoint(restored);
+    }
+
+    //Any checkpoint option turns on checkpointing, which also writes a final checkpoint when interrupted
+    if(ckpt.every > 0 || ckpt.path != (char *) NULL || restore_path != (char *) NULL) {
+        if(ckpt.path == (char *) NULL) {
+            ckpt.path = DEFAULT_CHECKPOINT_PATH;
+        }
+        install_stop_handlers();
+    }
 
+    //Load the region table, if we were asked for per-region counts
+    region_table *regions = NULL;
+    if(region_path != (char *) NULL) {
+        regions = (region_table *) malloc(sizeof(region_table));
+        if(load_regions(region_path, regions) < 0) {
+            printf("Invalid region file path \"%s\".\n", region_path);
+            exit(0);
+        }
+    }
 
     //Run the cache simulation with the trace file input
-    simulate_cache(cp, simulated_cache, trace_file);
+    if(regions != NULL) {
+        simulate_cache_regions(cp, simulated_cache, trace_file, regions);
+    } else {
+        simulate_cache(cp, simulated_cache, trace_file, ckpt.path != (char *) NULL ? &ckpt : NULL);
+    }
+
+    if(stop_requested && ckpt.failed) {
+        printf("Interrupted after %llu trace lines, but the checkpoint could not be saved. Partial results:\n",
+               ckpt.accesses);
+    } else if(stop_requested) {
+        printf("Interrupted after %llu trace lines, checkpoint written to \"%s\". Partial results:\n",
+               ckpt.accesses, ckpt.path);
+    }
 
     printSummary(cp->hits, cp->misses, cp->evictions);
 
+    //The state the user asked to keep is lost, so don't exit as if it were saved
+    if(stop_requested && ckpt.failed) {
+        exit(1);
+    }
+
+    if(regions != NULL) {
+        print_regions(stdout, regions);
+        free(regions);
+    }
+
+    //Continue every suffix trace from the warmed-up cache, unless we were interrupted during the prefix
+    if(num_suffixes > 0 && !stop_requested) {
+        fork_suffixes(cp, simulated_cache, suffix_paths, num_suffixes);
+    }
+
+#ifdef CSIM_PROBES
+    probe_report(stderr);
+#endif
+
     //Free memory allocated for the cache.
     free_cache(&simulated_cache);
     free(cp);
 
     return 0;
 }
+#endif /* CSIM_NO_MAIN */
 
 /**
  * Allocates the entire cache, including sets and lines.
@@ -309,9 +496,10 @@ void get_set_and_tag(location *loc, unsigned long long address, int tbits, int s
  * @param cp struct to fill in, specifying hit, miss, and eviction count.
  * @param sim_cache allocated cache to perform operations on
  * @param trace_file file handler for the specified trace file
+ * @param ckpt checkpoint settings, or NULL to run without checkpoints
  * @return fills in the cp variable with the hit, miss, and eviction count
  */
-void simulate_cache(cache_performance *cp, cache *sim_cache, FILE *trace_file) {
+void simulate_cache(cache_performance *cp, cache *sim_cache, FILE *trace_file, checkpoint_settings *ckpt) {
 
     //Allocate (with initialization) the 3 parameters of any trace line
     char *type = (char *) calloc(sizeof(char), 1);
@@ -325,29 +513,22 @@ void simulate_cache(cache_performance *cp, cache *sim_cache, FILE *trace_file) {
 
     //Loop through each line in the trace file
     while(fscanf(trace_file, " %c %x,%d\n", type, address, size) != -1) {
-        get_set_and_tag(loc, *address, sim_cache->tbits, sim_cache->sbits);
-        switch(*type) {
-            case 'M':
-                cp->hits++;
-            case 'S':
-            case 'L':
-                ;
-                //Load instruction. If HIT, increment. If COLD_MISS, pull up new LRU node. If MISS, perform an eviction
-                int result = cache_scan(loc, sim_cache);
-                if(result == HIT) {
-                    cp->hits++;
-                } else if(result == COLD_MISS || result == MISS) {
-                    cp->misses++;
-                    if (result == MISS) {
-                        cp->evictions++;
-                    };
-                }
-                break;
-            case 'I':
-                //Instruction instruction. Pass.
-                break;
-            default:
-                break;
+        simulate_access(cp, sim_cache, loc, *type, *address);
+
+        if(ckpt == NULL) {
+            continue;
+        }
+
+        //Checkpoint on schedule, and one last time if we were asked to stop
+        ckpt->accesses++;
+        if(stop_requested || (ckpt->every > 0 && ckpt->accesses % ckpt->every == 0)) {
+            ckpt->failed = write_checkpoint(ckpt->path, cp, sim_cache, ckpt->accesses, ftell(trace_file)) != 0;
+            if(ckpt->failed) {
+                printf("Could not write checkpoint \"%s\": %s\n", ckpt->path, strerror(errno));
+            }
+        }
+        if(stop_requested) {
+            break;
         }
     }
 
@@ -358,6 +539,135 @@ void simulate_cache(cache_performance *cp, cache *sim_cache, FILE *trace_file) {
     free(loc);
 }
 
+/**
+ * Runs a single trace line through the cache.
+ * @param cp counters to update
+ * @param sim_cache cache to perform the access on
+ * @param loc scratch location struct, filled in with the set and tag of the address
+ * @param type trace line type (L, S, M or I)
+ * @param address address of the access
+ */
+void simulate_access(cache_performance *cp, cache *sim_cache, location *loc, char type, unsigned long long address) {
+    get_set_and_tag(loc, address, sim_cache->tbits, sim_cache->sbits);
+    switch(type) {
+        case 'M':
+            cp->hits++;
+        case 'S':
+        case 'L':
+            ;
+            //Load instruction. If HIT, increment. If COLD_MISS, pull up new LRU node. If MISS, perform an eviction
+            int result = cache_scan(loc, sim_cache);
+            if(result == HIT) {
+                cp->hits++;
+            } else if(result == COLD_MISS || result == MISS) {
+                cp->misses++;
+                if (result == MISS) {
+                    cp->evictions++;
+                };
+            }
+            break;
+        case 'I':
+            //Instruction instruction. Pass.
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Loads the region table written by cl_region_begin/cl_region_end.
+ * @param path region file, one "id start end name" line per region
+ * @param table table to fill in, with all counters zeroed
+ * @return number of regions loaded, or -1 if the file can't be read
+ */
+int load_regions(const char *path, region_table *table) {
+    FILE *fp = fopen(path, "r");
+    if(fp == NULL) {
+        return -1;
+    }
+
+    memset(table, 0, sizeof(region_table));
+
+    int id;
+    while(table->count < CL_MAX_REGIONS &&
+          fscanf(fp, "%d %llx %llx %63[^\n]", &id, &table->start[table->count], &table->end[table->count],
+                 table->name[table->count]) == 4) {
+        table->count++;
+    }
+
+    fclose(fp);
+    return table->count;
+}
+
+/**
+ * Runs a single trace line through the cache and charges its outcome to every open region. A region's start marker
+ * opens it before the access is counted and its end marker closes it afterwards, so both marker writes count
+ * towards the region, just like a function's markers count towards its window.
+ * @param table region table to update
+ * @param cp counters to update
+ * @param sim_cache cache to perform the access on
+ * @param loc scratch location struct
+ * @param type trace line type (L, S, M or I)
+ * @param address address of the access
+ */
+void simulate_region_access(region_table *table, cache_performance *cp, cache *sim_cache, location *loc, char type,
+                            unsigned long long address) {
+    for(int i = 0; i < table->count; i++) {
+        if(address == table->start[i] && table->depth < CL_MAX_REGIONS) {
+            table->open[table->depth++] = i;
+            table->entered[i]++;
+            break;
+        }
+    }
+
+    cache_performance before = *cp;
+    simulate_access(cp, sim_cache, loc, type, address);
+
+    for(int i = 0; i < table->depth; i++) {
+        cache_performance *region = &table->perf[table->open[i]];
+        region->hits += cp->hits - before.hits;
+        region->misses += cp->misses - before.misses;
+        region->evictions += cp->evictions - before.evictions;
+    }
+
+    //Regions close innermost first
+    if(table->depth > 0 && address == table->end[table->open[table->depth - 1]]) {
+        table->depth--;
+    }
+}
+
+/**
+ * Prints the counts of every region that was entered at least once.
+ * @param out stream to print to
+ * @param table region table to print
+ */
+void print_regions(FILE *out, region_table *table) {
+    for(int i = 0; i < table->count; i++) {
+        if(table->entered[i] > 0) {
+            fprintf(out, "region %s (entered %d times): hits:%d misses:%d evictions:%d\n", table->name[i],
+                   table->entered[i], table->perf[i].hits, table->perf[i].misses, table->perf[i].evictions);
+        }
+    }
+}
+
+/**
+ * Simulates a whole trace file like simulate_cache, but also keeps per-region counts.
+ * @param cp struct to fill in, specifying hit, miss, and eviction count.
+ * @param sim_cache allocated cache to perform operations on
+ * @param trace_file file handler for the specified trace file
+ * @param table region table to update
+ */
+void simulate_cache_regions(cache_performance *cp, cache *sim_cache, FILE *trace_file, region_table *table) {
+    char type;
+    unsigned int address;
+    int size;
+    location loc;
+
+    while(fscanf(trace_file, " %c %x,%d\n", &type, &address, &size) != -1) {
+        simulate_region_access(table, cp, sim_cache, &loc, type, address);
+    }
+}
+
 /**
  * Scans the cache for the location provided. Returns whether that line resulted in a cache hit, cold miss, or miss.
  * @param loc location to search for
@@ -369,6 +679,9 @@ enum HitOrMiss cache_scan(location *loc, cache *sim_cache) {
     int set_id = loc->set_id;
     unsigned long long tag_id = loc->tag_id;
 
+    CSIM_PROBE(lookup, LOOKUP, set_id, tag_id);
+    CSIM_PROBE_TIMER(lookup_start);
+
     //Get the list of lines from the set we want to look at
     line *lines = sim_cache->sets[set_id].lines;
 
@@ -378,7 +691,10 @@ enum HitOrMiss cache_scan(location *loc, cache *sim_cache) {
     for (int i = 0; i < sim_cache->lines_per_set; i++) {
         //If we have a match, we have a hit. Return.
         if(lines[i].tag == tag_id && lines[i].valid) {
+            CSIM_PROBE_ELAPSED(LOOKUP, lookup_start);
+            CSIM_PROBE_TIMER(policy_start);
             LRU_hit(sim_cache, set_id, tag_id, i);
+            CSIM_PROBE_ELAPSED(POLICY, policy_start);
             return HIT;
         }
 
@@ -388,12 +704,17 @@ enum HitOrMiss cache_scan(location *loc, cache *sim_cache) {
         }
     }
 
+    CSIM_PROBE_ELAPSED(LOOKUP, lookup_start);
+    CSIM_PROBE_TIMER(policy_start);
+
     //If we don't get a hit and the cache is full, perform an eviction then return. Otherwise, just return.
     if(is_cache_full) {
         LRU_miss(sim_cache, set_id, tag_id);
+        CSIM_PROBE_ELAPSED(POLICY, policy_start);
         return MISS;
     } else {
         LRU_cold(sim_cache, set_id, tag_id);
+        CSIM_PROBE_ELAPSED(POLICY, policy_start);
         return COLD_MISS;
     }
 }
@@ -406,6 +727,9 @@ enum HitOrMiss cache_scan(location *loc, cache *sim_cache) {
  * @param z on a cache hit, z is the position in the lines array of the matching line to the tag id
  */
 void LRU_hit(cache *sim_cache, int set_id, unsigned long long tag_id, int z) {
+    CSIM_PROBE(hit, HIT, set_id, tag_id);
+    CSIM_PROBE(policy, POLICY, set_id, tag_id);
+
     //Grabbing the first real node of the linked list and storing it
     lru_node *current = sim_cache->lru_tracker[set_id];
     current = current->next;
@@ -452,6 +776,9 @@ void LRU_hit(cache *sim_cache, int set_id, unsigned long long tag_id, int z) {
  * @param tag_id the tag_id of whatever is being hit/missed in the cache
  */
 void LRU_cold(cache *sim_cache, int set_id, unsigned long long tag_id) {
+    CSIM_PROBE(fill, FILL, set_id, tag_id);
+    CSIM_PROBE(policy, POLICY, set_id, tag_id);
+
     //Grab the first real node of the lru_tracker and store it
     lru_node *current = sim_cache->lru_tracker[set_id];
     current = current->next;
@@ -499,6 +826,10 @@ void LRU_cold(cache *sim_cache, int set_id, unsigned long long tag_id) {
  * @param tag_id passes in the tag id that needs to be added to the simulated cache
  */
 void LRU_miss(cache *sim_cache, int set_id, unsigned long long tag_id) {
+    CSIM_PROBE(evict, EVICT, set_id, tag_id);
+    CSIM_PROBE(fill, FILL, set_id, tag_id);
+    CSIM_PROBE(policy, POLICY, set_id, tag_id);
+
     //Grab the first important node of the lru_tracker linked list and store it
     lru_node *current = sim_cache->lru_tracker[set_id];
     current = current->next;
@@ -530,9 +861,538 @@ void LRU_miss(cache *sim_cache, int set_id, unsigned long long tag_id) {
     return;
 }
 
+#ifdef CSIM_PROBES
+//Probe counters and cycle totals, indexed by ProbeId
+unsigned long long probe_counts[NUM_PROBES];
+unsigned long long probe_cycles[NUM_PROBES];
+
+/**
+ * Prints how often each probe fired and, for the timed ones, the average cycles spent per firing.
+ * @param out stream to print to
+ */
+void probe_report(FILE *out) {
+    const char *names[NUM_PROBES] = {"lookup", "hit", "fill", "evict", "policy"};
+
+    fprintf(out, "%-8s %14s %16s %10s\n", "probe", "count", "cycles", "cyc/call");
+    for(int i = 0; i < NUM_PROBES; i++) {
+        double per_call = probe_counts[i] ? (double) probe_cycles[i] / probe_counts[i] : 0.0;
+        fprintf(out, "%-8s %14llu %16llu %10.1f\n", names[i], probe_counts[i], probe_cycles[i], per_call);
+    }
+}
+#endif /* CSIM_PROBES */
+
+/**
+ * Writes the full cache state to a checkpoint file. The file is written next to the destination and renamed over
+ * it, so an interrupted write never clobbers the previous checkpoint.
+ * @param path checkpoint file to write
+ * @param cp current hit, miss, and eviction counters
+ * @param sim_cache cache to save
+ * @param accesses number of trace lines consumed so far
+ * @param trace_offset byte offset in the trace file of the next unread line
+ * @return 0 on success, -1 with errno set if the file could not be written (the previous checkpoint is then kept)
+ */
+int write_checkpoint(const char *path, cache_performance *cp, cache *sim_cache, unsigned long long accesses,
+                     long trace_offset) {
+    int num_sets = 1 << sim_cache->sbits;
+    int num_lines = num_sets * sim_cache->lines_per_set;
+
+    checkpoint_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.header_size = sizeof(checkpoint_header);
+    header.sbits = sim_cache->sbits;
+    header.lines_per_set = sim_cache->lines_per_set;
+    header.bytes_per_line = sim_cache->bytes_per_line;
+    header.hits = cp->hits;
+    header.misses = cp->misses;
+    header.evictions = cp->evictions;
+    header.accesses = accesses;
+    header.trace_offset = (uint64_t) trace_offset;
+    header.lines_offset = sizeof(checkpoint_header);
+    header.lru_offset = header.lines_offset + sizeof(checkpoint_line) * num_lines;
+    header.file_size = header.lru_offset + sizeof(uint32_t) * num_lines;
+
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *fp = fopen(tmp_path, "wb");
+    if(fp == NULL) {
+        return -1;
+    }
+
+    int ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+
+    //Lines, set major, in the same order as the sets' lines arrays
+    for(int i = 0; i < num_sets; i++) {
+        for(int j = 0; j < sim_cache->lines_per_set; j++) {
+            checkpoint_line saved = {sim_cache->sets[i].lines[j].tag, sim_cache->sets[i].lines[j].valid, 0};
+            ok = ok && fwrite(&saved, sizeof(saved), 1, fp) == 1;
+        }
+    }
+
+    //LRU order, walking each set's list from the front sentry node
+    for(int i = 0; i < num_sets; i++) {
+        lru_node *current = sim_cache->lru_tracker[i]->next;
+        for(int j = 0; j < sim_cache->lines_per_set; j++) {
+            uint32_t line_idx = current->idx - 1;
+            ok = ok && fwrite(&line_idx, sizeof(line_idx), 1, fp) == 1;
+            current = current->next;
+        }
+    }
+
+    //A short write or a failed flush leaves a partial file, which must not replace the previous checkpoint
+    if(fclose(fp) != 0 || !ok) {
+        int saved_errno = errno;
+        unlink(tmp_path);
+        errno = saved_errno;
+        return -1;
+    }
+    return rename(tmp_path, path);
+}
+
+/**
+ * Checks that every set's saved LRU order is a permutation of its line indices 0..E-1, so that apply_checkpoint can
+ * link each line into the list exactly once.
+ * @param header mapped checkpoint whose offsets and geometry have already been checked
+ * @return 1 if every order is a permutation, 0 if not
+ */
+int valid_lru_order(checkpoint_header *header) {
+    int lines_per_set = header->lines_per_set;
+    unsigned long long num_sets = 1ULL << header->sbits;
+    uint32_t *lru_order = (uint32_t *) ((char *) header + header->lru_offset);
+    unsigned long long *seen = (unsigned long long *) calloc(lines_per_set, sizeof(unsigned long long));
+    int valid = seen != NULL;
+
+    //seen[j] holds the number of the last set, counting from 1, whose order named line j
+    for(unsigned long long i = 0; valid && i < num_sets; i++) {
+        for(int j = 0; j < lines_per_set; j++) {
+            uint32_t line_idx = lru_order[i * lines_per_set + j];
+            if(line_idx >= (uint32_t) lines_per_set || seen[line_idx] == i + 1) {
+                valid = 0;
+                break;
+            }
+            seen[line_idx] = i + 1;
+        }
+    }
+
+    free(seen);
+    return valid;
+}
+
+/**
+ * Maps a checkpoint file into memory and checks that it is complete, of a version we understand, and that every set's
+ * LRU order is a permutation of its lines.
+ * @param path checkpoint file to map
+ * @return the mapped header, or NULL if the file is missing or invalid
+ */
+checkpoint_header *map_checkpoint(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if(fd == -1) {
+        return NULL;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) == -1 || st.st_size < (off_t) sizeof(checkpoint_header)) {
+        close(fd);
+        return NULL;
+    }
+
+    checkpoint_header *header = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(header == MAP_FAILED) {
+        return NULL;
+    }
+
+    unsigned long long num_lines = 0;
+    if(header->sbits >= 0 && header->sbits < 31 && header->lines_per_set > 0) {
+        num_lines = (1ULL << header->sbits) * header->lines_per_set;
+    }
+
+    if(memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0 ||
+       header->version != CHECKPOINT_VERSION || header->header_size != sizeof(checkpoint_header) ||
+       num_lines == 0 || header->file_size != (uint64_t) st.st_size ||
+       header->lru_offset != header->lines_offset + sizeof(checkpoint_line) * num_lines ||
+       header->file_size != header->lru_offset + sizeof(uint32_t) * num_lines) {
+        munmap(header, st.st_size);
+        return NULL;
+    }
+
+    if(!valid_lru_order(header)) {
+        munmap(header, st.st_size);
+        return NULL;
+    }
+
+    return header;
+}
+
+/**
+ * Loads a mapped checkpoint into an allocated cache of the same geometry, rebuilding each set's LRU list in the
+ * saved order.
+ * @param header mapped checkpoint
+ * @param cp counters to overwrite with the saved ones
+ * @param sim_cache cache to overwrite with the saved contents
+ */
+void apply_checkpoint(checkpoint_header *header, cache_performance *cp, cache *sim_cache) {
+    int num_sets = 1 << sim_cache->sbits;
+    int lines_per_set = sim_cache->lines_per_set;
+    checkpoint_line *saved_lines = (checkpoint_line *) ((char *) header + header->lines_offset);
+    uint32_t *lru_order = (uint32_t *) ((char *) header + header->lru_offset);
+    lru_node **nodes = (lru_node **) malloc(sizeof(lru_node *) * lines_per_set);
+
+    cp->hits = header->hits;
+    cp->misses = header->misses;
+    cp->evictions = header->evictions;
+
+    for(int i = 0; i < num_sets; i++) {
+        for(int j = 0; j < lines_per_set; j++) {
+            sim_cache->sets[i].lines[j].tag = saved_lines[i * lines_per_set + j].tag;
+            sim_cache->sets[i].lines[j].valid = saved_lines[i * lines_per_set + j].valid;
+        }
+
+        //Collect the real nodes by line index, then relink them between the two sentry nodes in the saved order
+        lru_node *front = sim_cache->lru_tracker[i];
+        lru_node *current = front->next;
+        for(int j = 0; j < lines_per_set; j++) {
+            nodes[current->idx - 1] = current;
+            current = current->next;
+        }
+        lru_node *back = current;
+
+        lru_node *previous = front;
+        for(int j = 0; j < lines_per_set; j++) {
+            lru_node *node = nodes[lru_order[i * lines_per_set + j]];
+            previous->next = node;
+            node->prev = previous;
+            previous = node;
+        }
+        previous->next = back;
+        back->prev = previous;
+    }
+
+    free(nodes);
+}
+
+void unmap_checkpoint(checkpoint_header *header) {
+    munmap(header, header->file_size);
+}
+
+/**
+ * Continues the simulation of a warmed-up cache with several different suffix traces. Every suffix runs in its own
+ * fork()ed child, so the children share the warm cache copy-on-write instead of replaying the prefix. Each child
+ * sends its counters back through a pipe, and the results are printed in command line order.
+ * @param cp counters after the prefix
+ * @param sim_cache cache after the prefix
+ * @param suffix_paths trace files to continue with
+ * @param num_suffixes number of suffix traces
+ */
+void fork_suffixes(cache_performance *cp, cache *sim_cache, char **suffix_paths, int num_suffixes) {
+    pid_t pids[MAX_FORKS];
+    int pipes[MAX_FORKS];
+
+    //Flush so that buffered output isn't duplicated by every child
+    fflush(stdout);
+
+    for(int i = 0; i < num_suffixes; i++) {
+        int fds[2];
+        if(pipe(fds) == -1) {
+            perror("pipe");
+            exit(1);
+        }
+
+        pids[i] = fork();
+        if(pids[i] == -1) {
+            perror("fork");
+            exit(1);
+        }
+
+        if(pids[i] == 0) {
+            //Child: simulate the suffix on our private copy of the cache, report the totals, and exit
+            close(fds[0]);
+            cache_performance result = *cp;
+            FILE *suffix_file = fopen(suffix_paths[i], "r");
+            if(suffix_file != NULL) {
+                simulate_cache(&result, sim_cache, suffix_file, NULL);
+                fclose(suffix_file);
+            } else {
+                result.hits = result.misses = result.evictions = -1;
+            }
+            if(write(fds[1], &result, sizeof(result)) != sizeof(result)) {
+                _exit(1);
+            }
+            _exit(0);
+        }
+
+        close(fds[1]);
+        pipes[i] = fds[0];
+    }
+
+    for(int i = 0; i < num_suffixes; i++) {
+        cache_performance result;
+        ssize_t got = read(pipes[i], &result, sizeof(result));
+        close(pipes[i]);
+        waitpid(pids[i], NULL, 0);
+
+        if(got != sizeof(result) || result.hits == -1) {
+            printf("fork %s: invalid trace file path\n", suffix_paths[i]);
+        } else {
+            printf("fork %s: hits:%d misses:%d evictions:%d\n", suffix_paths[i],
+                   result.hits, result.misses, result.evictions);
+        }
+    }
+}
+
+/**
+ * Signal handler for SIGINT and SIGALRM. Only sets a flag; simulate_cache writes the final checkpoint.
+ * @param signum signal number
+ */
+void stop_handler(int signum) {
+    stop_requested = 1;
+}
+
+/**
+ * Installs stop_handler for SIGINT and SIGALRM.
+ */
+void install_stop_handlers() {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stop_handler;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGALRM, &action, NULL);
+}
+
+/**
+ * Parses a direct-mapped geometry list of the form "s:b,s:b,...".
+ * @param list string given on the command line
+ * @param sbits filled in with the set bits of each geometry
+ * @param bbits filled in with the block bits of each geometry
+ * @return number of geometries parsed, or -1 if the list is malformed or too long
+ */
+int parse_dm_geometries(char *list, int *sbits, int *bbits) {
+    int lanes = 0;
+    char *p = list;
+
+    while(*p != '\0') {
+        if(lanes == DM_MAX_LANES) {
+            return -1;
+        }
+
+        char *end;
+        long s = strtol(p, &end, 10);
+        if(end == p || *end != ':') {
+            return -1;
+        }
+        p = end + 1;
+
+        long b = strtol(p, &end, 10);
+        if(end == p || (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        p = (*end == ',') ? end + 1 : end;
+
+        //Tags are stored as tag + 1 in 32 bits, so at least one address bit has to be dropped
+        if(s < 0 || b < 0 || s + b < 1 || s + b > 31) {
+            return -1;
+        }
+
+        sbits[lanes] = (int) s;
+        bbits[lanes] = (int) b;
+        lanes++;
+    }
+
+    return lanes;
+}
+
+/**
+ * Allocates the lane engine and lays out every lane's sets back to back in one tag array.
+ * @param dm filled in with the allocated engine
+ * @param lanes number of geometries
+ * @param sbits set bits of each geometry
+ * @param bbits block bits of each geometry
+ */
+void setup_dm_lanes(dm_lanes **dm, int lanes, int *sbits, int *bbits) {
+    *dm = (dm_lanes *) calloc(1, sizeof(dm_lanes));
+    (*dm)->lanes = lanes;
+    (*dm)->padded_lanes = ((lanes + DM_VECTOR_LANES - 1) / DM_VECTOR_LANES) * DM_VECTOR_LANES;
+
+    unsigned int total_sets = 0;
+    for(int i = 0; i < (*dm)->padded_lanes; i++) {
+        //Padding lanes get a single set and never report their counts
+        int s = (i < lanes) ? sbits[i] : 0;
+        int b = (i < lanes) ? bbits[i] : 1;
+
+        (*dm)->bbits[i] = b;
+        (*dm)->tshift[i] = s + b;
+        (*dm)->set_mask[i] = (1u << s) - 1;
+        (*dm)->base[i] = total_sets;
+        total_sets += 1u << s;
+    }
+
+    (*dm)->tags = (unsigned int *) calloc(total_sets, sizeof(unsigned int));
+}
+
+void free_dm_lanes(dm_lanes **dm) {
+    free((*dm)->tags);
+    free(*dm);
+    *dm = NULL;
+}
+
+/**
+ * Runs a trace through every lane at once. Accesses are buffered in batches so the vector engine can keep its
+ * counters in registers.
+ * @param dm lane engine to update
+ * @param trace_file file handler for the specified trace file
+ */
+void simulate_dm_lanes(dm_lanes *dm, FILE *trace_file) {
+    char *types = (char *) malloc(sizeof(char) * DM_BATCH);
+    unsigned int *addresses = (unsigned int *) malloc(sizeof(unsigned int) * DM_BATCH);
+    int count = 0;
+
+    char type;
+    unsigned int address;
+    int size;
+
+    while(fscanf(trace_file, " %c %x,%d\n", &type, &address, &size) != -1) {
+        //Instruction loads never touch the data cache
+        if(type != 'L' && type != 'S' && type != 'M') {
+            continue;
+        }
+
+        types[count] = type;
+        addresses[count] = address;
+        count++;
+
+        if(count == DM_BATCH) {
+            dm_lanes_batch(dm, types, addresses, count);
+            count = 0;
+        }
+    }
+
+    dm_lanes_batch(dm, types, addresses, count);
+
+    free(types);
+    free(addresses);
+}
+
+/**
+ * Picks the AVX2 engine when the host supports it, otherwise falls back to the scalar one.
+ */
+void dm_lanes_batch(dm_lanes *dm, const char *types, const unsigned int *addresses, int count) {
+    static int has_avx2 = -1;
+
+    if(has_avx2 == -1) {
+        __builtin_cpu_init();
+        has_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+
+    if(has_avx2) {
+        dm_lanes_batch_avx2(dm, types, addresses, count);
+    } else {
+        dm_lanes_batch_scalar(dm, types, addresses, count);
+    }
+}
+
+/**
+ * Portable lane engine. Each lane is a plain direct-mapped compare-and-replace.
+ */
+void dm_lanes_batch_scalar(dm_lanes *dm, const char *types, const unsigned int *addresses, int count) {
+    for(int n = 0; n < count; n++) {
+        unsigned int address = addresses[n];
+
+        for(int i = 0; i < dm->lanes; i++) {
+            unsigned int idx = dm->base[i] + ((address >> dm->bbits[i]) & dm->set_mask[i]);
+            unsigned int tag = (address >> dm->tshift[i]) + 1;
+
+            //A modify is a load followed by a store to the same line, so the store always hits
+            if(types[n] == 'M') {
+                dm->hits[i]++;
+            }
+
+            if(dm->tags[idx] == tag) {
+                dm->hits[i]++;
+            } else {
+                dm->misses[i]++;
+                if(dm->tags[idx] != 0) {
+                    dm->evictions[i]++;
+                }
+                dm->tags[idx] = tag;
+            }
+        }
+    }
+}
+
+/**
+ * AVX2 lane engine. DM_VECTOR_LANES lanes are handled per vector: the set index and tag of every lane are computed
+ * with variable shifts, the current tags are gathered, and only the missing lanes are written back. Lanes never share
+ * sets, so the write back order does not matter.
+ */
+__attribute__((target("avx2")))
+void dm_lanes_batch_avx2(dm_lanes *dm, const char *types, const unsigned int *addresses, int count) {
+    int vectors = dm->padded_lanes / DM_VECTOR_LANES;
+    unsigned int idx_out[DM_VECTOR_LANES];
+    unsigned int tag_out[DM_VECTOR_LANES];
+
+    for(int v = 0; v < vectors; v++) {
+        int first = v * DM_VECTOR_LANES;
+        __m256i bbits = _mm256_loadu_si256((const __m256i *) &dm->bbits[first]);
+        __m256i tshift = _mm256_loadu_si256((const __m256i *) &dm->tshift[first]);
+        __m256i set_mask = _mm256_loadu_si256((const __m256i *) &dm->set_mask[first]);
+        __m256i base = _mm256_loadu_si256((const __m256i *) &dm->base[first]);
+        __m256i hits = _mm256_loadu_si256((const __m256i *) &dm->hits[first]);
+        __m256i misses = _mm256_loadu_si256((const __m256i *) &dm->misses[first]);
+        __m256i evictions = _mm256_loadu_si256((const __m256i *) &dm->evictions[first]);
+        __m256i one = _mm256_set1_epi32(1);
+        __m256i zero = _mm256_setzero_si256();
+
+        for(int n = 0; n < count; n++) {
+            __m256i address = _mm256_set1_epi32((int) addresses[n]);
+            __m256i idx = _mm256_add_epi32(base, _mm256_and_si256(_mm256_srlv_epi32(address, bbits), set_mask));
+            __m256i tag = _mm256_add_epi32(_mm256_srlv_epi32(address, tshift), one);
+            __m256i current = _mm256_i32gather_epi32((const int *) dm->tags, idx, 4);
+
+            //Compare results are all ones (-1) in matching lanes, so subtracting them counts
+            __m256i hit = _mm256_cmpeq_epi32(current, tag);
+            __m256i cold = _mm256_cmpeq_epi32(current, zero);
+            __m256i miss = _mm256_andnot_si256(hit, _mm256_set1_epi32(-1));
+            __m256i evict = _mm256_andnot_si256(cold, miss);
+
+            if(types[n] == 'M') {
+                hits = _mm256_add_epi32(hits, one);
+            }
+            hits = _mm256_sub_epi32(hits, hit);
+            misses = _mm256_sub_epi32(misses, miss);
+            evictions = _mm256_sub_epi32(evictions, evict);
+
+            int miss_bits = _mm256_movemask_ps(_mm256_castsi256_ps(miss));
+            if(miss_bits != 0) {
+                _mm256_storeu_si256((__m256i *) idx_out, idx);
+                _mm256_storeu_si256((__m256i *) tag_out, tag);
+                while(miss_bits != 0) {
+                    int lane = __builtin_ctz(miss_bits);
+                    dm->tags[idx_out[lane]] = tag_out[lane];
+                    miss_bits &= miss_bits - 1;
+                }
+            }
+        }
+
+        _mm256_storeu_si256((__m256i *) &dm->hits[first], hits);
+        _mm256_storeu_si256((__m256i *) &dm->misses[first], misses);
+        _mm256_storeu_si256((__m256i *) &dm->evictions[first], evictions);
+    }
+}
+
 /**
  * Prints the command line usage of the executable. Used if the user did not correctly input parameters.
  */
 void print_usage() {
     printf("Usage: ./csim [-hv] -s <s> -E <E> -b <b> -t <tracefile>\n");
+    printf("       ./csim -D <s:b,s:b,...> -t <tracefile>\n");
+    printf("  -D  simulate up to %d direct-mapped (E=1) geometries in one pass over the trace\n", DM_MAX_LANES);
+    printf("  -R <f>   also report hits, misses, and evictions per region listed in region file f (%s)\n",
+           CL_REGION_FILE);
+    printf("  --checkpoint-every <n>   checkpoint the cache state every n trace lines\n");
+    printf("  --checkpoint-file <f>    checkpoint file (default %s)\n", DEFAULT_CHECKPOINT_PATH);
+    printf("  --restore <f>            resume from a checkpoint; -s/-E/-b default to the checkpoint's\n");
+    printf("  --fork <f>               after the trace, continue a copy of the warm cache with trace f (repeatable)\n");
+    printf("SIGINT or SIGALRM while checkpointing writes a final checkpoint and prints partial results.\n");
 }
@@ -0,0 +1,147 @@
+/*
+Cachelab -- CS 2011
+csim.h - Cache simulator engine shared by csim and the tools that link it in-process.
+Build csim.c with -DCSIM_NO_MAIN to get the engine without the command line front end.
+*/
+
+#ifndef CSIM_H
+#define CSIM_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "cachelab.h"
+
+/**
+ * Struct representing a location of data within the cache
+ * @param set_id index of the set
+ * @param tag_id tag of the line
+ */
+typedef struct location {
+    int set_id;
+    unsigned long long tag_id;
+} location;
+
+//Enum representing a cache hit, cold miss, or miss
+enum HitOrMiss {HIT, COLD_MISS, MISS};
+
+/**
+ * Struct to store the performance of the cache.
+ * @param hits number of cache hits
+ * @param misses number of cache misses
+ * @param evictions number of cache evictions
+ */
+typedef struct cache_performance {
+    int hits;
+    int misses;
+    int evictions;
+} cache_performance;
+
+/**
+ * Struct representing a single line within a set in a cache
+ * @param valid whether or not this line is caching data. 0 if the cache hasn't been fully warmed up
+ * @param tag number representing the tag for this cache line
+ */
+typedef struct line {
+    bool valid;
+    unsigned long long tag; //ensure 64-bit address compatibility
+} line;
+
+/**
+ * Struct representing a single set in the simulated cache
+ * @param id index of the set in the cache's set array
+ * @param lines list of lines within each specific set
+ */
+typedef struct set {
+    int id;
+    line *lines;
+} set;
+
+/**
+ * Struct for a node in the linked lists managing the LRU eviction policy. Declared before the cache so that it knows
+ * the type lru_node.
+ * @param prev previous node in the LL
+ * @param next subsequent node in the LL
+ * @param idx index into the lines array for the set the linked list is responsible for
+ */
+typedef struct lru_node {
+    struct lru_node *prev;
+    struct lru_node *next;
+    int idx; //Index into the array of lines in the set
+} lru_node;
+
+/**
+ * Struct representing the cache to be simulated.
+ * @param sets list of sets the cache will simulate (2^s)
+ * @param lines_per_set how many lines there are per set (E)
+ * @param bytes_per_line how many bytes each cache block will store (2^b)
+ * @param sbits number of bits for the set id
+ * @param tbits number of bits for the tag
+ * @param verbose unused, was used for printing debugging information originally
+ */
+typedef struct cache {
+    set *sets;
+    int lines_per_set;
+    int bytes_per_line;
+    int sbits;
+    int tbits;
+    bool verbose;
+    lru_node **lru_tracker;
+} cache;
+
+/**
+ * Struct describing when and where simulate_cache writes checkpoints.
+ * @param every write a checkpoint after this many trace lines, 0 to only checkpoint on SIGINT/SIGALRM
+ * @param path file the checkpoints are written to
+ * @param accesses number of trace lines consumed so far, including those before a restore
+ * @param failed whether the last checkpoint could not be written
+ */
+typedef struct checkpoint_settings {
+    long long every;
+    char *path;
+    unsigned long long accesses;
+    int failed;
+} checkpoint_settings;
+
+/**
+ * Struct holding the named regions written by cl_region_begin/cl_region_end and the counts attributed to each.
+ * An access counts towards every region that is open when it happens, including the region's own marker writes.
+ * @param count number of regions in the table
+ * @param start address written when a region is entered
+ * @param end address written when a region is left
+ * @param name name of each region
+ * @param entered number of times each region was entered
+ * @param perf hits, misses, and evictions inside each region
+ * @param open stack of currently open region ids
+ * @param depth number of open regions
+ */
+typedef struct region_table {
+    int count;
+    unsigned long long start[CL_MAX_REGIONS];
+    unsigned long long end[CL_MAX_REGIONS];
+    char name[CL_MAX_REGIONS][CL_REGION_NAME_LEN];
+    int entered[CL_MAX_REGIONS];
+    cache_performance perf[CL_MAX_REGIONS];
+    int open[CL_MAX_REGIONS];
+    int depth;
+} region_table;
+
+//Cache setup and teardown
+void setup_cache(cache **sim_cache, int sbits, int lines_per_set, int bytes_per_line, int tbits);
+void free_cache(cache **sim_cache);
+
+//Address decoding and lookup
+void get_set_and_tag(location *loc, unsigned long long address, int tbits, int sbits);
+enum HitOrMiss cache_scan(struct location *loc, cache *sim_cache);
+
+//Simulation of a whole trace file, or of a single access
+void simulate_cache(cache_performance *cp, cache *sim_cache, FILE *trace_file, checkpoint_settings *ckpt);
+void simulate_access(cache_performance *cp, cache *sim_cache, location *loc, char type, unsigned long long address);
+
+//Per-region statistics
+int load_regions(const char *path, region_table *table);
+void simulate_region_access(region_table *table, cache_performance *cp, cache *sim_cache, location *loc, char type,
+                            unsigned long long address);
+void simulate_cache_regions(cache_performance *cp, cache *sim_cache, FILE *trace_file, region_table *table);
+void print_regions(FILE *out, region_table *table);
+
+#endif /* CSIM_H */
@@ -0,0 +1,212 @@
+/*
+ * kernelgen.c - Writes a C file of transpose kernels specialized for fixed
+ *     sizes and blocking configurations (see blocking.h), together with
+ *     registerGeneratedFunctions(), which registers all of them.
+ *
+ * Each line of the spec file names a size and lists values for any of
+ * the blocking parameters; every combination that is valid for the size
+ * becomes one kernel. Ranges lo:hi are allowed for bh and bw. Parameters
+ * left out take the default shown here:
+ *
+ *     # size  parameter=value[,value...]
+ *     32x32   bh=8 bw=8 order=rows inner=rows copy=direct diag=same unroll=1
+ *     64x64   bh=4:8 bw=4,8 copy=direct,buffer diag=same,defer
+ *
+ * Build with make GEN=<spec> to link the kernels into test-trans and the
+ * tracers, where they are tagged "generated" and "<M>x<N>".
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "blocking.h"
+
+#define NUM_KEYS 7
+#define MAX_VALUES 64
+#define VALUE_LEN 16
+
+static const char *keys[NUM_KEYS] = {"bh", "bw", "order", "inner", "copy", "diag", "unroll"};
+static const char *defaults[NUM_KEYS] = {"8", "8", "rows", "rows", "direct", "same", "1"};
+
+/* The values listed for each key on one spec line */
+typedef struct spec_line {
+    int M, N;
+    int count[NUM_KEYS];
+    char value[NUM_KEYS][MAX_VALUES][VALUE_LEN];
+} spec_line;
+
+static int num_kernels;
+static FILE *registrations;
+
+/*
+ * parse_values - Split "a,b,lo:hi" into key k's values. Returns -1 on error.
+ */
+static int parse_values(spec_line *spec, int k, char *list)
+{
+    char *save;
+
+    spec->count[k] = 0;
+    for (char *v = strtok_r(list, ",", &save); v != NULL; v = strtok_r(NULL, ",", &save)) {
+        int lo, hi;
+        if (sscanf(v, "%d:%d", &lo, &hi) != 2)
+            lo = hi = -1;
+        do {
+            if (spec->count[k] == MAX_VALUES)
+                return -1;
+            if (lo >= 0)
+                snprintf(spec->value[k][spec->count[k]++], VALUE_LEN, "%d", lo);
+            else
+                snprintf(spec->value[k][spec->count[k]++], VALUE_LEN, "%s", v);
+        } while (lo >= 0 && ++lo <= hi);
+    }
+    return spec->count[k] > 0 ? 0 : -1;
+}
+
+/*
+ * parse_spec - Parse one line. Returns 0 if it is blank, 1 if it holds a
+ *     spec, and -1 on error.
+ */
+static int parse_spec(char *line, spec_line *spec)
+{
+    char *save, *tok;
+    char *hash = strchr(line, '#');
+
+    if (hash)
+        *hash = '\0';
+    if ((tok = strtok_r(line, " \t\r\n", &save)) == NULL)
+        return 0;
+    if (sscanf(tok, "%dx%d", &spec->M, &spec->N) != 2 || spec->M < 1 || spec->N < 1)
+        return -1;
+    for (int k = 0; k < NUM_KEYS; k++) {
+        spec->count[k] = 1;
+        strcpy(spec->value[k][0], defaults[k]);
+    }
+    while ((tok = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+        char *eq = strchr(tok, '=');
+        int k;
+        if (eq == NULL)
+            return -1;
+        *eq = '\0';
+        for (k = 0; k < NUM_KEYS && strcmp(keys[k], tok) != 0; k++)
+            ;
+        if (k == NUM_KEYS || parse_values(spec, k, eq + 1) < 0)
+            return -1;
+    }
+    return 1;
+}
+
+/*
+ * emit_kernel - Write the kernel for one combination of values, unless
+ *     it isn't valid for the size. Returns -1 if a value is malformed.
+ */
+static int emit_kernel(FILE *out, spec_line *spec, int *pick)
+{
+    char text[256], params[300], name[64];
+    blocking cfg;
+    int unroll = atoi(spec->value[6][pick[6]]);
+
+    snprintf(text, sizeof(text), "bh=%s,bw=%s,order=%s,inner=%s,copy=%s,diag=%s",
+             spec->value[0][pick[0]], spec->value[1][pick[1]], spec->value[2][pick[2]],
+             spec->value[3][pick[3]], spec->value[4][pick[4]], spec->value[5][pick[5]]);
+    if (blocking_parse(text, &cfg) < 0)
+        return -1;
+    if (!blocking_valid(spec->M, spec->N, &cfg))
+        return 0;
+
+    blocking_describe(&cfg, text, sizeof(text));
+    snprintf(params, sizeof(params), "%s,unroll=%d", text, unroll != 0);
+    snprintf(name, sizeof(name), "gen_%dx%d_%d", spec->M, spec->N, num_kernels++);
+    fprintf(out, "\nstatic char %s_desc[] = \"Generated %dx%d (%s)\";\n", name, spec->M, spec->N, params);
+    fprintf(out, "static ");
+    blocking_emit_c(out, name, spec->M, spec->N, &cfg, unroll);
+    fprintf(registrations, "    registerTransFunctionInfo(%s, %s_desc, \"%s\", \"generated,%dx%d\", 1);\n",
+            name, name, params, spec->M, spec->N);
+    return 0;
+}
+
+/*
+ * emit_spec - Write every combination of a spec line's values
+ */
+static int emit_spec(FILE *out, spec_line *spec)
+{
+    int pick[NUM_KEYS] = {0};
+
+    for (;;) {
+        if (emit_kernel(out, spec, pick) < 0)
+            return -1;
+        int k = 0;
+        while (k < NUM_KEYS && ++pick[k] == spec->count[k])
+            pick[k++] = 0;
+        if (k == NUM_KEYS)
+            return 0;
+    }
+}
+
+static void usage(char *argv[])
+{
+    printf("Usage: %s [-h] -f <spec> [-o <file>]\n", argv[0]);
+    printf("  -f <spec>  kernel spec (format in kernelgen.c)\n");
+    printf("  -o <file>  where to write the kernels (default trans-gen.c)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    char *spec_path = NULL, *out_path = "trans-gen.c";
+    char line[1024];
+    char *reg_text = NULL;
+    size_t reg_len = 0;
+    int c, lineno = 0;
+
+    while ((c = getopt(argc, argv, "hf:o:")) != -1) {
+        switch (c) {
+        case 'f': spec_path = optarg; break;
+        case 'o': out_path = optarg; break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+    if (spec_path == NULL) {
+        usage(argv);
+        exit(1);
+    }
+
+    FILE *fp = fopen(spec_path, "r");
+    if (fp == NULL) {
+        printf("Error: can't open \"%s\"\n", spec_path);
+        exit(1);
+    }
+    FILE *out = fopen(out_path, "w");
+    if (out == NULL || (registrations = open_memstream(&reg_text, &reg_len)) == NULL) {
+        printf("Error: can't write \"%s\"\n", out_path);
+        exit(1);
+    }
+
+    fprintf(out, "/*\n * %s - Generated by kernelgen from %s. Do not edit.\n */\n", out_path, spec_path);
+    fprintf(out, "#include \"cachelab.h\"\n");
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        spec_line spec;
+        int status;
+        lineno++;
+        if ((status = parse_spec(line, &spec)) == 0)
+            continue;
+        if (status < 0 || emit_spec(out, &spec) < 0) {
+            printf("%s: line %d: bad spec\n", spec_path, lineno);
+            fclose(out);
+            remove(out_path);
+            exit(1);
+        }
+    }
+    fclose(fp);
+    fclose(registrations);
+
+    fprintf(out, "\nvoid registerGeneratedFunctions(void)\n{\n%s}\n", reg_text);
+    fclose(out);
+    free(reg_text);
+    printf("%s: %d kernels\n", out_path, num_kernels);
+    return 0;
+}
@@ -0,0 +1,12 @@
+# Kernels for make GEN=kernels.spec (format in kernelgen.c). Each line
+# expands to every valid combination of the values it lists.
+
+# 32x32: square blocks with every diagonal strategy, then wide and tall ones
+32x32  bh=4:8 bw=4:8 order=rows,cols inner=rows,cols copy=direct,buffer diag=same,defer,buffer
+32x32  bh=1,2 bw=8 order=rows,cols copy=direct,buffer
+
+# 64x64: blocks no deeper than four rows of B, where the sets start to repeat
+64x64  bh=1:4 bw=4,8 order=rows,cols inner=rows,cols copy=direct,buffer diag=same,defer,buffer
+
+# 61x67: block heights that divide the rows differently, for both orders
+61x67  bh=4:16 bw=4,8 order=rows,cols copy=direct,buffer
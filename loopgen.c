@@ -0,0 +1,130 @@
+/*
+ * loopgen.c - Generates the address stream of an affine loop nest (see
+ *     loopnest.h) and simulates it in-process, or writes it out as a
+ *     valgrind-style trace for csim.
+ *
+ * The matrix bases in a description should match the program being
+ * modelled; they move with the build, so pass the ones ./tracegen-cap -m
+ * prints for the size with -D rather than trusting a file's defaults.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include "csim.h"
+#include "loopnest.h"
+
+#define MAX_DEFINES 64
+
+/* Simulation state handed to the sink */
+typedef struct loopgen_ctx {
+    cache *sim_cache;
+    cache_performance perf;
+    location loc;
+    FILE *trace_fp;
+} loopgen_ctx;
+
+static void simulate_sink(void *arg, char type, unsigned long long addr, int size)
+{
+    loopgen_ctx *ctx = arg;
+    simulate_access(&ctx->perf, ctx->sim_cache, &ctx->loc, type, addr);
+}
+
+static void count_sink(void *arg, char type, unsigned long long addr, int size)
+{
+}
+
+static void trace_sink(void *arg, char type, unsigned long long addr, int size)
+{
+    loopgen_ctx *ctx = arg;
+    fprintf(ctx->trace_fp, " %c %08llx,%d\n", type, addr, size);
+    if (ctx->sim_cache)
+        simulate_access(&ctx->perf, ctx->sim_cache, &ctx->loc, type, addr);
+}
+
+static void usage(char *argv[])
+{
+    printf("Usage: %s [-hn] -f <loopfile> [-s <s> -E <E> -b <b>] [-D <name>=<value>]... [-o <trace>]\n", argv[0]);
+    printf("  -f <file>  loop-nest description\n");
+    printf("  -s/-E/-b   simulate a cache with this geometry (default 5/1/5)\n");
+    printf("  -D n=v     set param n to v, overriding the file\n");
+    printf("  -o <file>  also write the accesses as a trace csim can read\n");
+    printf("  -n         only generate the accesses, to time the generator alone\n");
+}
+
+int main(int argc, char *argv[])
+{
+    char *loop_path = NULL, *trace_path = NULL;
+    char *defines[MAX_DEFINES + 1];
+    int num_defines = 0, s = 5, E = 1, b = 5, generate_only = 0;
+    char err[256];
+    int c;
+
+    while ((c = getopt(argc, argv, "hnf:s:E:b:D:o:")) != -1) {
+        switch (c) {
+        case 'f': loop_path = optarg; break;
+        case 's': s = atoi(optarg); break;
+        case 'E': E = atoi(optarg); break;
+        case 'b': b = atoi(optarg); break;
+        case 'o': trace_path = optarg; break;
+        case 'n': generate_only = 1; break;
+        case 'D':
+            if (num_defines == MAX_DEFINES) {
+                printf("Error: too many -D options\n");
+                exit(1);
+            }
+            defines[num_defines++] = optarg;
+            break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+    defines[num_defines] = NULL;
+
+    if (loop_path == NULL || s < 0 || E < 1 || b < 0 || s + b > 63) {
+        usage(argv);
+        exit(1);
+    }
+
+    FILE *fp = fopen(loop_path, "r");
+    if (fp == NULL) {
+        printf("Error: can't open \"%s\"\n", loop_path);
+        exit(1);
+    }
+    ln_program *prog = ln_parse(fp, defines, err, sizeof(err));
+    fclose(fp);
+    if (prog == NULL) {
+        printf("%s: %s\n", loop_path, err);
+        exit(1);
+    }
+
+    loopgen_ctx ctx = {0};
+    setup_cache(&ctx.sim_cache, s, E, b, 64 - (s + b));
+    if (trace_path && (ctx.trace_fp = fopen(trace_path, "w")) == NULL) {
+        printf("Error: can't write \"%s\"\n", trace_path);
+        exit(1);
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ln_sink sink = generate_only ? count_sink : ctx.trace_fp ? trace_sink : simulate_sink;
+    unsigned long long accesses = ln_run(prog, sink, &ctx);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    if (ctx.trace_fp)
+        fclose(ctx.trace_fp);
+    printf("accesses:%llu seconds:%.3f throughput:%.2f Maccesses/s\n",
+           accesses, seconds, seconds > 0 ? accesses / seconds / 1e6 : 0.0);
+    printf("hits:%d misses:%d evictions:%d\n", ctx.perf.hits, ctx.perf.misses, ctx.perf.evictions);
+
+    free_cache(&ctx.sim_cache);
+    ln_free(prog);
+    return 0;
+}
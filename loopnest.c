@@ -0,0 +1,417 @@
+/*
+ * loopnest.c - Parser and address generator for affine loop nests
+ *     (see loopnest.h for the description format).
+ *
+ * Every bound and address is kept as an affine function of the enclosing
+ * loop variables, so generating an access is a dot product. Innermost
+ * loops, whose bodies are only accesses, go further and just add a
+ * constant stride to each address per iteration.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "loopnest.h"
+
+typedef struct ln_array {
+    char name[LN_NAME_LEN];
+    long long base;
+    long long elem;
+    long long cols;
+} ln_array;
+
+/* Parser state */
+typedef struct ln_parser {
+    ln_program *prog;
+    ln_array arrays[LN_MAX_ARRAYS];
+    int num_arrays;
+    char vars[LN_MAX_DEPTH][LN_NAME_LEN]; /* loop variables in scope, by depth */
+    ln_node **tail[LN_MAX_DEPTH + 1];     /* where the next node at each depth goes */
+    int depth;
+    int line;
+    char *err;
+    size_t err_len;
+} ln_parser;
+
+static int ln_error(ln_parser *ps, const char *msg, const char *what)
+{
+    snprintf(ps->err, ps->err_len, "line %d: %s%s%s", ps->line, msg, what ? " " : "", what ? what : "");
+    return -1;
+}
+
+/*
+ * ln_lookup_param - Index of a param, or -1
+ */
+static int ln_lookup_param(ln_program *prog, const char *name)
+{
+    for (int i = 0; i < prog->num_params; i++) {
+        if (strcmp(prog->param_name[i], name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/*
+ * ln_set_param - Define or redefine a param. Returns -1 if the table is full.
+ */
+static int ln_set_param(ln_program *prog, const char *name, long long value)
+{
+    int i = ln_lookup_param(prog, name);
+
+    if (i < 0) {
+        if (prog->num_params == LN_MAX_PARAMS)
+            return -1;
+        i = prog->num_params++;
+        snprintf(prog->param_name[i], LN_NAME_LEN, "%s", name);
+    }
+    prog->param_value[i] = value;
+    return 0;
+}
+
+/*
+ * ln_parse_factor - Parse an integer literal or a name. A name that is a
+ *     loop variable in scope sets *var to its depth; a param is folded
+ *     into *value.
+ */
+static int ln_parse_factor(ln_parser *ps, const char **s, long long *value, int *var)
+{
+    char name[LN_NAME_LEN];
+    int n = 0;
+
+    *var = -1;
+    if (isdigit((unsigned char) **s)) {
+        char *end;
+        *value = strtoll(*s, &end, 0);
+        *s = end;
+        return 0;
+    }
+    while (isalnum((unsigned char) **s) || **s == '_') {
+        if (n < LN_NAME_LEN - 1)
+            name[n++] = **s;
+        (*s)++;
+    }
+    name[n] = '\0';
+    if (n == 0)
+        return ln_error(ps, "expected a number or a name at", *s);
+
+    for (int d = ps->depth - 1; d >= 0; d--) {
+        if (strcmp(ps->vars[d], name) == 0) {
+            *var = d;
+            *value = 1;
+            return 0;
+        }
+    }
+    int p = ln_lookup_param(ps->prog, name);
+    if (p < 0)
+        return ln_error(ps, "unknown name", name);
+    *value = ps->prog->param_value[p];
+    return 0;
+}
+
+/*
+ * ln_parse_affine - Parse a sum of terms, each a product of factors with
+ *     at most one loop variable, e.g. 2*i+bj-M
+ */
+static int ln_parse_affine(ln_parser *ps, const char *s, ln_affine *out)
+{
+    memset(out, 0, sizeof(ln_affine));
+    while (*s) {
+        long long sign = 1, coeff = 1, value;
+        int var = -1, factor_var;
+
+        while (*s == '+' || *s == '-') {
+            if (*s == '-')
+                sign = -sign;
+            s++;
+        }
+        for (;;) {
+            if (ln_parse_factor(ps, &s, &value, &factor_var) < 0)
+                return -1;
+            if (factor_var >= 0) {
+                if (var >= 0)
+                    return ln_error(ps, "product of loop variables is not affine", NULL);
+                var = factor_var;
+            }
+            coeff *= value;
+            if (*s != '*')
+                break;
+            s++;
+        }
+
+        if (var >= 0)
+            out->c[var] += sign * coeff;
+        else
+            out->c0 += sign * coeff;
+        if (*s && *s != '+' && *s != '-')
+            return ln_error(ps, "unexpected character in expression:", s);
+    }
+    return 0;
+}
+
+/*
+ * ln_parse_const - Parse an affine expression that may only use params
+ */
+static int ln_parse_const(ln_parser *ps, const char *s, long long *value)
+{
+    ln_affine a;
+    int depth = ps->depth;
+
+    ps->depth = 0;
+    int ret = ln_parse_affine(ps, s, &a);
+    ps->depth = depth;
+    *value = a.c0;
+    return ret;
+}
+
+/*
+ * ln_append - Add a node at the current depth
+ */
+static ln_node *ln_append(ln_parser *ps)
+{
+    ln_node *node = calloc(1, sizeof(ln_node));
+
+    if (node == NULL)
+        return NULL;
+    node->depth = ps->depth;
+    *ps->tail[ps->depth] = node;
+    ps->tail[ps->depth] = &node->next;
+    return node;
+}
+
+/*
+ * ln_parse_line - Parse one statement
+ */
+static int ln_parse_line(ln_parser *ps, char *line)
+{
+    char *tok[8], *save;
+    int n = 0;
+
+    char *hash = strchr(line, '#');
+    if (hash)
+        *hash = '\0';
+    for (char *t = strtok_r(line, " \t\r\n", &save); t != NULL && n < 8; t = strtok_r(NULL, " \t\r\n", &save))
+        tok[n++] = t;
+    if (n == 0)
+        return 0;
+
+    if (strcmp(tok[0], "param") == 0) {
+        long long value;
+        if (n != 3)
+            return ln_error(ps, "usage: param <name> <value>", NULL);
+        /* Values given with -D win over the file */
+        if (ln_lookup_param(ps->prog, tok[1]) >= 0)
+            return 0;
+        if (ln_parse_const(ps, tok[2], &value) < 0)
+            return -1;
+        if (ln_set_param(ps->prog, tok[1], value) < 0)
+            return ln_error(ps, "too many params", NULL);
+        return 0;
+    }
+
+    if (strcmp(tok[0], "array") == 0) {
+        ln_array *a = &ps->arrays[ps->num_arrays];
+        if (n != 5)
+            return ln_error(ps, "usage: array <name> <base> <element size> <row length>", NULL);
+        if (ps->num_arrays == LN_MAX_ARRAYS)
+            return ln_error(ps, "too many arrays", NULL);
+        snprintf(a->name, LN_NAME_LEN, "%s", tok[1]);
+        if (ln_parse_const(ps, tok[2], &a->base) < 0 || ln_parse_const(ps, tok[3], &a->elem) < 0 ||
+            ln_parse_const(ps, tok[4], &a->cols) < 0)
+            return -1;
+        ps->num_arrays++;
+        return 0;
+    }
+
+    if (strcmp(tok[0], "for") == 0) {
+        ln_node *node;
+        if (n != 4 && n != 5)
+            return ln_error(ps, "usage: for <var> <lo> <hi> [step]", NULL);
+        if (ps->depth == LN_MAX_DEPTH)
+            return ln_error(ps, "loops nested too deeply", NULL);
+        if ((node = ln_append(ps)) == NULL)
+            return ln_error(ps, "out of memory", NULL);
+        node->is_loop = 1;
+        node->step = 1;
+        if (ln_parse_affine(ps, tok[2], &node->lo) < 0 || ln_parse_affine(ps, tok[3], &node->hi) < 0 ||
+            (n == 5 && ln_parse_const(ps, tok[4], &node->step) < 0))
+            return -1;
+        if (node->step < 1)
+            return ln_error(ps, "step must be positive", NULL);
+        snprintf(ps->vars[ps->depth], LN_NAME_LEN, "%s", tok[1]);
+        ps->depth++;
+        ps->tail[ps->depth] = &node->body;
+        return 0;
+    }
+
+    if (strcmp(tok[0], "end") == 0) {
+        if (ps->depth == 0)
+            return ln_error(ps, "end without for", NULL);
+        ps->depth--;
+        return 0;
+    }
+
+    if (strcmp(tok[0], "load") == 0 || strcmp(tok[0], "store") == 0 || strcmp(tok[0], "modify") == 0) {
+        ln_affine row, col;
+        ln_array *a = NULL;
+        ln_node *node;
+
+        if (n != 4)
+            return ln_error(ps, "usage: load|store|modify <array> <row> <column>", NULL);
+        for (int i = 0; i < ps->num_arrays; i++) {
+            if (strcmp(ps->arrays[i].name, tok[1]) == 0)
+                a = &ps->arrays[i];
+        }
+        if (a == NULL)
+            return ln_error(ps, "unknown array", tok[1]);
+        if (ln_parse_affine(ps, tok[2], &row) < 0 || ln_parse_affine(ps, tok[3], &col) < 0)
+            return -1;
+        if ((node = ln_append(ps)) == NULL)
+            return ln_error(ps, "out of memory", NULL);
+
+        /* base + elem * (row * cols + col) */
+        node->type = toupper((unsigned char) tok[0][0]);
+        node->size = a->elem;
+        node->addr.c0 = a->base + a->elem * (row.c0 * a->cols + col.c0);
+        for (int d = 0; d < ps->depth; d++)
+            node->addr.c[d] = a->elem * (row.c[d] * a->cols + col.c[d]);
+        return 0;
+    }
+
+    return ln_error(ps, "unknown statement", tok[0]);
+}
+
+static void ln_free_nodes(ln_node *node)
+{
+    while (node) {
+        ln_node *next = node->next;
+        ln_free_nodes(node->body);
+        free(node);
+        node = next;
+    }
+}
+
+void ln_free(ln_program *prog)
+{
+    if (prog) {
+        ln_free_nodes(prog->root);
+        free(prog);
+    }
+}
+
+ln_program *ln_parse(FILE *fp, char **defines, char *err, size_t err_len)
+{
+    ln_parser ps;
+    char line[1024];
+
+    memset(&ps, 0, sizeof(ps));
+    ps.err = err;
+    ps.err_len = err_len;
+    ps.prog = calloc(1, sizeof(ln_program));
+    if (ps.prog == NULL) {
+        snprintf(err, err_len, "out of memory");
+        return NULL;
+    }
+    ps.tail[0] = &ps.prog->root;
+
+    for (int i = 0; defines && defines[i]; i++) {
+        char name[LN_NAME_LEN];
+        long long value;
+        if (sscanf(defines[i], "%31[^=]=%lli", name, &value) != 2 || ln_set_param(ps.prog, name, value) < 0) {
+            snprintf(err, err_len, "bad define \"%s\"", defines[i]);
+            ln_free(ps.prog);
+            return NULL;
+        }
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        ps.line++;
+        if (ln_parse_line(&ps, line) < 0) {
+            ln_free(ps.prog);
+            return NULL;
+        }
+    }
+    if (ps.depth != 0) {
+        ln_error(&ps, "missing end", NULL);
+        ln_free(ps.prog);
+        return NULL;
+    }
+    return ps.prog;
+}
+
+ln_program *ln_parse_string(const char *text, char **defines, char *err, size_t err_len)
+{
+    FILE *fp = fmemopen((void *) text, strlen(text), "r");
+    ln_program *prog;
+
+    if (fp == NULL) {
+        snprintf(err, err_len, "out of memory");
+        return NULL;
+    }
+    prog = ln_parse(fp, defines, err, err_len);
+    fclose(fp);
+    return prog;
+}
+
+static long long ln_eval(const ln_affine *a, const long long *vals, int depth)
+{
+    long long v = a->c0;
+    for (int d = 0; d < depth; d++)
+        v += a->c[d] * vals[d];
+    return v;
+}
+
+/*
+ * ln_exec - Run a list of sibling nodes with the enclosing variables in vals
+ */
+static unsigned long long ln_exec(ln_node *node, long long *vals, ln_sink sink, void *ctx)
+{
+    unsigned long long count = 0;
+
+    for (; node; node = node->next) {
+        if (!node->is_loop) {
+            sink(ctx, node->type, ln_eval(&node->addr, vals, node->depth), node->size);
+            count++;
+            continue;
+        }
+
+        int d = node->depth;
+        long long lo = ln_eval(&node->lo, vals, d), hi = ln_eval(&node->hi, vals, d);
+        int leaf = 1, num = 0;
+
+        for (ln_node *b = node->body; b; b = b->next) {
+            leaf &= !b->is_loop;
+            num++;
+        }
+
+        if (!leaf || num > 64) {
+            for (vals[d] = lo; vals[d] < hi; vals[d] += node->step)
+                count += ln_exec(node->body, vals, sink, ctx);
+            continue;
+        }
+
+        /* Innermost loop: every address advances by a fixed stride */
+        long long addr[64], stride[64];
+        ln_node *b = node->body;
+        vals[d] = lo;
+        for (int k = 0; k < num; k++, b = b->next) {
+            addr[k] = ln_eval(&b->addr, vals, d + 1);
+            stride[k] = b->addr.c[d] * node->step;
+        }
+        for (long long v = lo; v < hi; v += node->step) {
+            b = node->body;
+            for (int k = 0; k < num; k++, b = b->next) {
+                sink(ctx, b->type, addr[k], b->size);
+                addr[k] += stride[k];
+            }
+            count += num;
+        }
+    }
+    return count;
+}
+
+unsigned long long ln_run(ln_program *prog, ln_sink sink, void *ctx)
+{
+    long long vals[LN_MAX_DEPTH] = {0};
+    return ln_exec(prog->root, vals, sink, ctx);
+}
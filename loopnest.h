@@ -0,0 +1,82 @@
+/*
+ * loopnest.h - Affine loop-nest descriptions and the address streams
+ *     they generate, so a transpose blocking can be simulated without
+ *     running or tracing any code.
+ *
+ * A description is a line-oriented text file:
+ *
+ *     # 32x32 transpose in 8x8 blocks
+ *     param M 32
+ *     param N 32
+ *     array A 0x404100 4 M        # name, base address, element size, row length
+ *     array B 0x444100 4 N
+ *     for bi 0 N 8                # variable, low bound, exclusive high bound, step
+ *       for bj 0 M 8
+ *         for i bi bi+8
+ *           for j bj bj+8
+ *             load A i j          # load/store/modify array row column
+ *             store B j i
+ *           end
+ *         end
+ *       end
+ *     end
+ *
+ * Bounds, bases, row lengths and indices are affine expressions (sums of
+ * integer multiples of params and enclosing loop variables) written
+ * without spaces, e.g. 2*i+bj-1. Loops may be imperfectly nested.
+ */
+#ifndef LOOPNEST_H
+#define LOOPNEST_H
+
+#include <stdio.h>
+
+#define LN_MAX_DEPTH 16
+#define LN_MAX_PARAMS 64
+#define LN_MAX_ARRAYS 16
+#define LN_NAME_LEN 32
+
+/* c0 + sum of c[d] * (value of the loop variable at depth d) */
+typedef struct ln_affine {
+    long long c0;
+    long long c[LN_MAX_DEPTH];
+} ln_affine;
+
+/* A loop or an access, in a singly linked list of siblings */
+typedef struct ln_node {
+    int is_loop;
+    int depth;              /* number of enclosing loops */
+    ln_affine lo, hi;       /* loop bounds, in enclosing variables */
+    long long step;
+    struct ln_node *body;
+    char type;              /* access type: L, S or M */
+    int size;               /* access size in bytes */
+    ln_affine addr;         /* access address, in enclosing variables */
+    struct ln_node *next;
+} ln_node;
+
+typedef struct ln_program {
+    int num_params;
+    char param_name[LN_MAX_PARAMS][LN_NAME_LEN];
+    long long param_value[LN_MAX_PARAMS];
+    ln_node *root;
+} ln_program;
+
+/* Receives every generated access */
+typedef void (*ln_sink)(void *ctx, char type, unsigned long long addr, int size);
+
+/*
+ * ln_parse - Parse a description. defines holds "name=value" overrides
+ *     for params (NULL terminated, may be NULL). Returns NULL and writes
+ *     a message with the line number to err on failure.
+ */
+ln_program *ln_parse(FILE *fp, char **defines, char *err, size_t err_len);
+
+/* Parse a description held in a string */
+ln_program *ln_parse_string(const char *text, char **defines, char *err, size_t err_len);
+
+/* Stream every access of the program to sink, returning the number of accesses */
+unsigned long long ln_run(ln_program *prog, ln_sink sink, void *ctx);
+
+void ln_free(ln_program *prog);
+
+#endif /* LOOPNEST_H */
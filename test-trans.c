@@ -3,6 +3,7 @@
  *     student's transpose functions and records the results for their
  *     official submitted version as well.
  */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -11,12 +12,36 @@
 #include <signal.h>
 #include <getopt.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include "cachelab.h"
+#include "csim.h"
 #include <sys/wait.h> // fir WEXITSTATUS
 #include <limits.h> // for INT_MAX
+#include <elf.h>
+#include <dirent.h>
+#include <fnmatch.h>
 
-/* Maximum array dimension */
-#define MAXN 256
+/* Maximum array dimension (tracegen's limit) */
+#define MAXN 8192
+
+/* Per-function working directories for parallel evaluation live here */
+#define WORK_DIR ".test-trans.d"
+
+/* Traces and results are cached here, keyed by each function's code */
+#define CACHE_DIR ".trans-cache"
+
+/* Bump whenever tracing or simulation changes what a cached entry means */
+#define CACHE_VERSION 4
+
+/* Window traces are cached only for matrices up to this size */
+#define CACHE_TRACE_MAXN 256
+
+/* Maximum number of cache geometries evaluated at once */
+#define MAX_GEOMS 16
+
+/* What -g standard adds to the graded cache: the same 1KB with more ways
+   or other line sizes, and a 32KB 8-way L1 */
+#define STANDARD_GEOMETRIES "4:2:5,3:4:5,6:1:4,4:1:6,6:8:6"
 
 /* The description string for the transpose_submit() function that the
    student submits for credit */
@@ -26,12 +51,50 @@
 extern void registerFunctions();
 
 /* External variables defined in cachelab-tools.c */
-extern trans_func_t func_list[MAX_TRANS_FUNCS];
+extern trans_func_t* func_list;
 extern int func_counter; 
 
 /* Globals set on the command line */
 static int M = 0;
 static int N = 0;
+static int capture = 0; /* trace with ./tracegen-cap instead of valgrind */
+static int jobs = 0;    /* functions evaluated concurrently, 0 if not given */
+static int single_run = 0; /* trace every function in one tracegen run */
+static int use_cache = 1;  /* reuse cached traces and results */
+static char* name_filter = NULL; /* only evaluate functions whose description matches */
+static char* tag_filter = NULL;  /* only evaluate functions with this tag */
+static long alignment = 0; /* of the matrices in tracegen; 0 keeps the lab's layout */
+
+/* Directory holding tracegen, so workers can run it from their own directory */
+static char tool_dir[PATH_MAX];
+
+/* Each function's key apart from the matrix size, or 0 if it can't be cached */
+static unsigned long long* code_key;
+
+/* Cache key of each function's trace, or 0 if it can't be cached */
+static unsigned long long* trace_key;
+
+/* Indices of the functions selected by the filters, in order */
+static int* sel;
+static int num_sel;
+
+/* Cache geometries to evaluate. The first one is the one that is scored. */
+struct geometry {
+    unsigned int s;
+    unsigned int E;
+    unsigned int b;
+};
+static struct geometry geoms[MAX_GEOMS];
+static int num_geoms = 1;
+
+/* Ranges of M and N swept when either -M or -N is given as lo:hi[:step] */
+struct range {
+    int lo;
+    int hi;
+    int step;
+};
+static struct range m_range, n_range;
+static int sweeping = 0;
 
 /* The correctness and performance for the submitted transpose function */
 struct results {
@@ -41,135 +104,1255 @@ struct results {
 };
 static struct results results = {-1, 0, INT_MAX};
 
-/* 
- * eval_perf - Evaluate the performance of the registered transpose functions
+/* A function's marker pair and validity, as recorded by tracegen in .marker,
+   and whether split_windows found its window closed by the end marker */
+struct marker {
+    unsigned long long start;
+    unsigned long long end;
+    int valid;
+    int closed;
+};
+
+/*
+ * read_markers - Read every function's marker pair from .marker into
+ *     markers, which has room for one per registered function. Returns
+ *     the number of pairs read, or -1 if there is no .marker.
  */
-void eval_perf(unsigned int s, unsigned int E, unsigned int b)
+static int read_markers(struct marker* markers)
 {
-    int i,flag;
-    unsigned int len, hits, misses, evictions;
-    unsigned long long int marker_start, marker_end, addr;
-    char buf[1000], cmd[255];
-    char filename[128];
+    int n = 0;
+    FILE* marker_fp = fopen(".marker", "r");
+    if (!marker_fp)
+        return -1;
+    while (n < func_counter &&
+           fscanf(marker_fp, "%llx %llx %d", &markers[n].start,
+                  &markers[n].end, &markers[n].valid) == 3) {
+        markers[n].closed = 0;
+        n++;
+    }
+    fclose(marker_fp);
+    return n;
+}
 
-    registerFunctions(); 
+/*
+ * split_windows - Split a full trace into the windows between each
+ *     function's markers in a single pass. Functions run in order, so
+ *     the next window can only open at the next run function's own start
+ *     marker. The accesses in function i's window are written to out[i]
+ *     in the same format, unless out[i] is NULL, and markers[i].closed is
+ *     set once its end marker is seen. Returns the number of windows
+ *     closed.
+ */
+static int split_windows(FILE* full_trace_fp, struct marker* markers, int n,
+                         FILE** out)
+{
+    char buf[1000];
+    unsigned int len;
+    unsigned long long addr;
+    int current = -1, next = 0, found = 0;
 
-    /* Open the complete trace file */
-    FILE* full_trace_fp;  
-    FILE* part_trace_fp; 
+    /* Locate trace corresponding to each trans function */
+    while (fgets(buf, 1000, full_trace_fp) != NULL) {
 
-    /* Evaluate the performance of each registered transpose function */
+        /* We are only interested in memory access instructions */
+        if (buf[0]==' ' && buf[2]==' ' &&
+            (buf[1]=='S' || buf[1]=='M' || buf[1]=='L' )) {
+            sscanf(buf+3, "%llx,%u", &addr, &len);
 
-    for (i=0; i<func_counter; i++) {
-        if (strcmp(func_list[i].description, SUBMIT_DESCRIPTION) == 0 )
-            results.funcid = i; /* remember which function is the submission */
+            /* If a start marker is found, the window of the next function begins */
+            if (current == -1) {
+                while (next < n && markers[next].valid == -1)
+                    next++;
+                if (next < n && addr == markers[next].start)
+                    current = next++;
+            }
 
+            /* Valgrind creates many spurious accesses to the
+               stack that have nothing to do with the students
+               code. At the moment, we are ignoring all stack
+               accesses by using the simple filter of recording
+               accesses to only the low 32-bit portion of the
+               address space. At some point it would be nice to
+               try to do more informed filtering so that would
+               eliminate the valgrind stack references while
+               include the student stack references. */
+            if (current != -1 && addr < 0xffffffff && out[current])
+                fputs(buf, out[current]);
 
-        printf("\nFunction %d (%d total)\nStep 1: Validating and generating memory traces\n",i,func_counter);
-        /* Use valgrind to generate the trace */
+            /* if the end marker is found, the window is over */
+            if (current != -1 && addr == markers[current].end) {
+                markers[current].closed = 1;
+                found++;
+                current = -1;
+            }
+        }
+    }
+    return found;
+}
 
-        sprintf(cmd, "valgrind --tool=lackey --trace-mem=yes --log-fd=1 -v ./tracegen -M %d -N %d -F %d  > trace.tmp", M, N,i);
-        flag=WEXITSTATUS(system(cmd));
-        if (0!=flag) {
-            printf("Validation error at function %d! Run ./tracegen -M %d -N %d -F %d for details.\nSkipping performance evaluation for this function.\n",flag-1,M,N,i);      
-            continue;
+/*
+ * fnv_hash - Fold n bytes into a 64-bit FNV-1a hash
+ */
+#define FNV_INIT 0xcbf29ce484222325ULL
+static unsigned long long fnv_hash(unsigned long long h, const void* p, size_t n)
+{
+    const unsigned char* c = p;
+    while (n--) {
+        h ^= *c++;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/* What a result depends on besides the kernels' code: the simulator, and
+   the tracer that runs the kernels, by the sources it is built from (its
+   binaries also hold every kernel, so hashing those would drop the whole
+   cache on any change to trans.c) */
+static const char* tool_files[] = {
+    "csim-engine.o", "tracegen.c", "tracecap.c", "cachelab.c", "cachelab.h", "Makefile"
+};
+#define NUM_TOOL_FILES (sizeof(tool_files) / sizeof(tool_files[0]))
+
+/*
+ * hash_file - Fold the contents of the file at path into h, which a
+ *     missing file leaves as it is
+ */
+static unsigned long long hash_file(unsigned long long h, const char* path)
+{
+    unsigned char buf[65536];
+    size_t n;
+    FILE* fp = fopen(path, "rb");
+
+    if (!fp)
+        return h;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        h = fnv_hash(h, buf, n);
+    fclose(fp);
+    return h;
+}
+
+/* The object hash_code is reading */
+static unsigned char* obj;
+static size_t obj_size;
+static Elf64_Shdr* obj_sh;
+static int obj_shnum;
+static Elf64_Sym* obj_syms;
+static int obj_nsyms;
+static const char* obj_strtab;
+static const char* obj_shstrtab;
+
+/*
+ * load_object - Read a relocatable x86-64 ELF object and locate its
+ *     section headers and symbol table. Returns 0 on success.
+ */
+static int load_object(const char* path)
+{
+    FILE* fp = fopen(path, "rb");
+    Elf64_Ehdr* eh;
+
+    if (!fp)
+        return -1;
+    fseek(fp, 0, SEEK_END);
+    obj_size = ftell(fp);
+    rewind(fp);
+    obj = malloc(obj_size);
+    if (!obj || fread(obj, 1, obj_size, fp) != obj_size) {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    eh = (Elf64_Ehdr*) obj;
+    if (obj_size < sizeof(Elf64_Ehdr) || memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 ||
+        eh->e_ident[EI_CLASS] != ELFCLASS64 || eh->e_type != ET_REL ||
+        eh->e_shoff + (size_t) eh->e_shnum * sizeof(Elf64_Shdr) > obj_size)
+        return -1;
+    obj_sh = (Elf64_Shdr*) (obj + eh->e_shoff);
+    obj_shnum = eh->e_shnum;
+    obj_shstrtab = (const char*) obj + obj_sh[eh->e_shstrndx].sh_offset;
+
+    for (int i = 0; i < obj_shnum; i++) {
+        if (obj_sh[i].sh_offset + obj_sh[i].sh_size > obj_size &&
+            obj_sh[i].sh_type != SHT_NOBITS)
+            return -1;
+        if (obj_sh[i].sh_type == SHT_SYMTAB) {
+            obj_syms = (Elf64_Sym*) (obj + obj_sh[i].sh_offset);
+            obj_nsyms = obj_sh[i].sh_size / sizeof(Elf64_Sym);
+            obj_strtab = (const char*) obj + obj_sh[obj_sh[i].sh_link].sh_offset;
         }
+    }
+    return obj_syms ? 0 : -1;
+}
 
-        /* Get the start and end marker addresses */
-        FILE* marker_fp = fopen(".marker", "r");
-        assert(marker_fp);
-        fscanf(marker_fp, "%llx %llx", &marker_start, &marker_end);
-        fclose(marker_fp);
+/*
+ * func_code - The bytes of function symbol k in the object
+ */
+static const unsigned char* func_code(int k)
+{
+    return obj + obj_sh[obj_syms[k].st_shndx].sh_offset + obj_syms[k].st_value;
+}
 
+/*
+ * Iterate over the relocations that patch function symbol k. The bytes
+ *     they cover differ between the object and the linked program.
+ */
+#define for_each_reloc(k, r) \
+    for (int sec_ = 0; sec_ < obj_shnum; sec_++) \
+        if (obj_sh[sec_].sh_type == SHT_RELA && \
+            obj_sh[sec_].sh_info == obj_syms[k].st_shndx) \
+            for (Elf64_Rela* r = (Elf64_Rela*) (obj + obj_sh[sec_].sh_offset); \
+                 r < (Elf64_Rela*) (obj + obj_sh[sec_].sh_offset + obj_sh[sec_].sh_size); r++) \
+                if (r->r_offset >= obj_syms[k].st_value && \
+                    r->r_offset < obj_syms[k].st_value + obj_syms[k].st_size)
+
+/*
+ * func_matches - True if code is function symbol k as linked into this
+ *     program, i.e. every byte not covered by a relocation is the same.
+ *     The linker may also rewrite the opcode in front of a GOT load.
+ */
+static int func_matches(int k, const unsigned char* code)
+{
+    size_t size = obj_syms[k].st_size;
+    unsigned char* mask = calloc(size, 1);
+    int match = 1;
 
-        func_list[i].correct=1;
+    assert(mask);
+    for_each_reloc(k, r) {
+        size_t off = r->r_offset - obj_syms[k].st_value;
+        int type = ELF64_R_TYPE(r->r_info);
+        size_t from = (type == R_X86_64_GOTPCRELX || type == R_X86_64_REX_GOTPCRELX) && off >= 3 ? off - 3 : off;
+        size_t to = off + (type == R_X86_64_64 ? 8 : 4);
+        for (size_t j = from; j < to && j < size; j++)
+            mask[j] = 1;
+    }
+    for (size_t j = 0; j < size && match; j++)
+        if (!mask[j] && code[j] != func_code(k)[j])
+            match = 0;
+    free(mask);
+    return match;
+}
 
-        /* Save the correctness of the transpose submission */
-        if (results.funcid == i ) {
-            results.correct = 1;
+/*
+ * func_at - Index of the function symbol in section shndx that contains
+ *     offset, or -1
+ */
+static int func_at(int shndx, long long offset)
+{
+    for (int k = 0; k < obj_nsyms; k++) {
+        if (ELF64_ST_TYPE(obj_syms[k].st_info) == STT_FUNC && obj_syms[k].st_shndx == shndx &&
+            offset >= (long long) obj_syms[k].st_value &&
+            offset < (long long) (obj_syms[k].st_value + obj_syms[k].st_size))
+            return k;
+    }
+    return -1;
+}
+
+/*
+ * hash_data - Fold the initial bytes of the data symbol t refers to into
+ *     h: the object itself, or the whole section for a section symbol
+ *     (string literals and constants the compiler placed there). Symbols
+ *     in .bss or outside the object add nothing, since their starting
+ *     contents can't change.
+ */
+static unsigned long long hash_data(unsigned long long h, Elf64_Sym* t)
+{
+    Elf64_Shdr* sec;
+
+    if (t->st_shndx == SHN_UNDEF || t->st_shndx >= obj_shnum)
+        return h;
+    sec = &obj_sh[t->st_shndx];
+    if (!(sec->sh_flags & SHF_ALLOC) || (sec->sh_flags & SHF_EXECINSTR) || sec->sh_type == SHT_NOBITS)
+        return h;
+    if (ELF64_ST_TYPE(t->st_info) == STT_SECTION)
+        return fnv_hash(h, obj + sec->sh_offset, sec->sh_size);
+    if (t->st_value + t->st_size <= sec->sh_size)
+        return fnv_hash(h, obj + sec->sh_offset + t->st_value, t->st_size);
+    return h;
+}
+
+/*
+ * hash_symbol - Hash function symbol k's code and what it refers to.
+ *     Calls into other functions of the object fold in their hash, so
+ *     editing a helper changes the key of every function that uses it,
+ *     while moving code around in the object changes nothing. The data
+ *     it refers to is hashed by content, so changing a table or a
+ *     constant a kernel reads changes its key too.
+ */
+static unsigned long long hash_symbol(int k, int depth)
+{
+    unsigned long long h = fnv_hash(FNV_INIT, func_code(k), obj_syms[k].st_size);
+
+    for_each_reloc(k, r) {
+        Elf64_Sym* t = &obj_syms[ELF64_R_SYM(r->r_info)];
+        unsigned long long off = r->r_offset - obj_syms[k].st_value;
+        int target = -1;
+
+        h = fnv_hash(h, &off, sizeof(off));
+        h = fnv_hash(h, &r->r_info, sizeof(r->r_info));
+        if (t->st_shndx != SHN_UNDEF && t->st_shndx < obj_shnum) {
+            if (ELF64_ST_TYPE(t->st_info) == STT_FUNC)
+                target = t - obj_syms;
+            else if (ELF64_ST_TYPE(t->st_info) == STT_SECTION &&
+                     (obj_sh[t->st_shndx].sh_flags & SHF_EXECINSTR))
+                target = func_at(t->st_shndx, t->st_value + r->r_addend + 4);
         }
 
-        full_trace_fp = fopen("trace.tmp", "r");
-        assert(full_trace_fp);
-
-
-        /* Filtered trace for each transpose function goes in a separate file */
-        sprintf(filename, "trace.f%d", i);
-        part_trace_fp = fopen(filename, "w");
-        assert(part_trace_fp);
-    
-        /* Locate trace corresponding to the trans function */
-        flag = 0;
-        while (fgets(buf, 1000, full_trace_fp) != NULL) {
-
-            /* We are only interested in memory access instructions */
-            if (buf[0]==' ' && buf[2]==' ' &&
-                (buf[1]=='S' || buf[1]=='M' || buf[1]=='L' )) {
-                sscanf(buf+3, "%llx,%u", &addr, &len);
-        
-                /* If start marker found, set flag */
-                if (addr == marker_start)
-                    flag = 1;
-
-                /* Valgrind creates many spurious accesses to the
-                   stack that have nothing to do with the students
-                   code. At the moment, we are ignoring all stack
-                   accesses by using the simple filter of recording
-                   accesses to only the low 32-bit portion of the
-                   address space. At some point it would be nice to
-                   try to do more informed filtering so that would
-                   eliminate the valgrind stack references while
-                   include the student stack references. */
-                if (flag && addr < 0xffffffff) {
-                    fputs(buf, part_trace_fp);
-                }
+        if (target >= 0) {
+            unsigned long long th = (target == k || depth >= 8) ? 0 : hash_symbol(target, depth + 1);
+            h = fnv_hash(h, &th, sizeof(th));
+        } else {
+            const char* name = ELF64_ST_TYPE(t->st_info) == STT_SECTION ?
+                obj_shstrtab + obj_sh[t->st_shndx].sh_name : obj_strtab + t->st_name;
+            h = fnv_hash(h, name, strlen(name));
+            h = fnv_hash(h, &r->r_addend, sizeof(r->r_addend));
+            h = hash_data(h, t);
+        }
+    }
+    return h;
+}
+
+/* Objects holding the registered functions: trans.c, and the kernels
+   kernelgen generates when the build links them in */
+static const char* trans_objects[] = {"trans.o", "trans-gen.o"};
+#define NUM_TRANS_OBJECTS (sizeof(trans_objects) / sizeof(trans_objects[0]))
 
-                /* if end marker found, close trace file */
-                if (addr == marker_end) {
-                    flag = 0;
-                    fclose(part_trace_fp);
-                    break;
+static void unload_object(void)
+{
+    free(obj);
+    obj = NULL;
+    obj_syms = NULL;
+}
+
+/*
+ * hash_code - Compute each function's key apart from the matrix size, from
+ *     its code in trans.o (or trans-gen.o), the alignment, the tracer,
+ *     the simulator (tool_files) and CACHE_VERSION. The sizes of the
+ *     objects' data sections are included as well, since they move the
+ *     matrices in tracegen. Only function only is hashed, unless only is
+ *     -1. A function whose code can't be found gets key 0 and is always
+ *     re-evaluated.
+ */
+static void hash_code(int only)
+{
+    char path[PATH_MAX + 16];
+    unsigned long long base = FNV_INIT;
+    int version = CACHE_VERSION, found = 0;
+
+    free(code_key);
+    code_key = calloc(func_counter, sizeof(unsigned long long));
+    assert(code_key || func_counter == 0);
+
+    base = fnv_hash(base, &version, sizeof(version));
+    base = fnv_hash(base, &capture, sizeof(capture));
+    base = fnv_hash(base, &alignment, sizeof(alignment));
+    for (size_t t = 0; t < NUM_TOOL_FILES; t++) {
+        sprintf(path, "%s/%s", tool_dir, tool_files[t]);
+        base = fnv_hash(base, tool_files[t], strlen(tool_files[t]));
+        base = hash_file(base, path);
+    }
+    for (int o = 0; o < NUM_TRANS_OBJECTS; o++) {
+        sprintf(path, "%s/%s", tool_dir, trans_objects[o]);
+        if (load_object(path) == 0) {
+            found = 1;
+            for (int j = 0; j < obj_shnum; j++) {
+                if ((obj_sh[j].sh_flags & SHF_ALLOC) && !(obj_sh[j].sh_flags & SHF_EXECINSTR))
+                    base = fnv_hash(base, &obj_sh[j].sh_size, sizeof(obj_sh[j].sh_size));
+            }
+        }
+        unload_object();
+    }
+    if (!found)
+        return;
+
+    for (int o = 0; o < NUM_TRANS_OBJECTS; o++) {
+        sprintf(path, "%s/%s", tool_dir, trans_objects[o]);
+        if (load_object(path) == 0) {
+            for (int i = 0; i < func_counter; i++) {
+                const unsigned char* code = func_list[i].func_ptr ?
+                    (const unsigned char*) func_list[i].func_ptr : (const unsigned char*) func_list[i].inplace_ptr;
+                if (code_key[i] || (only != -1 && i != only))
+                    continue;
+                for (int k = 0; k < obj_nsyms; k++) {
+                    if (ELF64_ST_TYPE(obj_syms[k].st_info) == STT_FUNC && obj_syms[k].st_size > 0 &&
+                        obj_syms[k].st_shndx < obj_shnum && func_matches(k, code)) {
+                        unsigned long long h = hash_symbol(k, 0);
+                        code_key[i] = fnv_hash(base, &h, sizeof(h)) | 1;
+                        break;
+                    }
                 }
             }
         }
-        fclose(full_trace_fp);
-
-        /* Run the reference simulator */
-        printf("Step 2: Evaluating performance (s=%d, E=%d, b=%d)\n", s, E, b);
-        char cmd[255];
-        sprintf(cmd, "./csim-ref -s %u -E %u -b %u -t trace.f%d > /dev/null", 
-                s, E, b, i);
-        system(cmd);
-    
-        /* Collect results from the reference simulator */
-        FILE* in_fp = fopen(".csim_results","r");
-        assert(in_fp);
-        fscanf(in_fp, "%u %u %u", &hits, &misses, &evictions);
-        fclose(in_fp);
-        func_list[i].num_hits = hits;
-        func_list[i].num_misses = misses;
-        func_list[i].num_evictions = evictions;
+        unload_object();
+    }
+}
+
+/*
+ * key_functions - Mix the matrix size into every hashed function's key,
+ *     giving the cache key of its trace at M x N
+ */
+static void key_functions(void)
+{
+    free(trace_key);
+    trace_key = calloc(func_counter, sizeof(unsigned long long));
+    assert(trace_key || func_counter == 0);
+
+    for (int i = 0; i < func_counter; i++) {
+        if (!code_key[i])
+            continue;
+        trace_key[i] = fnv_hash(code_key[i], &M, sizeof(M));
+        trace_key[i] = fnv_hash(trace_key[i], &N, sizeof(N)) | 1;
+    }
+}
+
+/*
+ * trace_cached - True if function i's window trace is kept in the cache.
+ *     Above the lab's sizes a trace runs to hundreds of MB, so only its
+ *     results are cached.
+ */
+static int trace_cached(int i)
+{
+    return trace_key[i] && M <= CACHE_TRACE_MAXN && N <= CACHE_TRACE_MAXN;
+}
+
+/*
+ * trace_path/result_path/regions_path - Where function i's window trace,
+ *     its result for geometry g, and its region table are kept. Functions
+ *     whose trace isn't cached keep it in trace.f<i>.
+ */
+static void trace_path(char* path, int i)
+{
+    if (trace_cached(i))
+        sprintf(path, "%s/%s/%016llx.trace", tool_dir, CACHE_DIR, trace_key[i]);
+    else
+        sprintf(path, "trace.f%d", i);
+}
+
+static void result_path(char* path, int i, int g)
+{
+    sprintf(path, "%s/%s/%016llx-%u-%u-%u.result", tool_dir, CACHE_DIR, trace_key[i],
+            geoms[g].s, geoms[g].E, geoms[g].b);
+}
+
+static void regions_path(char* path, int i)
+{
+    if (trace_cached(i))
+        sprintf(path, "%s/%s/%016llx.regions", tool_dir, CACHE_DIR, trace_key[i]);
+    else
+        strcpy(path, CL_REGION_FILE);
+}
+
+/*
+ * cache_create/cache_commit - Write a cache entry under a name private to
+ *     this process, then rename it into place, so that concurrent workers
+ *     never see a partial entry.
+ */
+static FILE* cache_create(const char* path, char* tmp)
+{
+    sprintf(tmp, "%s.%d", path, (int) getpid());
+    return fopen(tmp, "w");
+}
+
+static void cache_commit(FILE* fp, const char* tmp, const char* path)
+{
+    fclose(fp);
+    rename(tmp, path);
+}
+
+/*
+ * store_windows - After a tracegen run, save the window of every function
+ *     with want[i] set, along with the run's region table. A window that
+ *     was never closed (the tracer died in it) is not cached.
+ */
+static void store_windows(struct marker* markers, int n, const char* want)
+{
+    char (*path)[PATH_MAX + 64] = malloc(n * sizeof(*path));
+    char (*tmp)[PATH_MAX + 80] = malloc(n * sizeof(*tmp));
+    char rpath[PATH_MAX + 64], rtmp[PATH_MAX + 80], buf[1000];
+    FILE** out = calloc(n, sizeof(FILE*));
+    FILE* full_trace_fp = fopen("trace.tmp", "r");
+
+    assert(full_trace_fp && path && tmp && out);
+    for (int i = 0; i < n && i < func_counter; i++) {
+        if (!want[i])
+            continue;
+        trace_path(path[i], i);
+        if (trace_cached(i))
+            out[i] = cache_create(path[i], tmp[i]);
+        else
+            out[i] = fopen(path[i], "w");
+    }
+    split_windows(full_trace_fp, markers, n, out);
+    fclose(full_trace_fp);
+
+    for (int i = 0; i < n && i < func_counter; i++) {
+        if (out[i] && trace_cached(i) && !markers[i].closed) {
+            fclose(out[i]);
+            unlink(tmp[i]);
+            continue;
+        }
+        if (!out[i] || !trace_cached(i)) {
+            if (out[i])
+                fclose(out[i]);
+            continue;
+        }
+
+        /* The region table goes in before the trace that needs it */
+        regions_path(rpath, i);
+        FILE* in = fopen(CL_REGION_FILE, "r");
+        if (in) {
+            FILE* rfp = cache_create(rpath, rtmp);
+            if (rfp) {
+                while (fgets(buf, sizeof(buf), in) != NULL)
+                    fputs(buf, rfp);
+                cache_commit(rfp, rtmp, rpath);
+            }
+            fclose(in);
+        } else {
+            unlink(rpath);
+        }
+        cache_commit(out[i], tmp[i], path[i]);
+    }
+    free(path);
+    free(tmp);
+    free(out);
+}
+
+/* Outcome of evaluating one registered function, for every geometry */
+struct func_eval {
+    int correct;
+    cache_performance perf[MAX_GEOMS];
+};
+
+/* Every function's outcome, for the misses matrix */
+static struct func_eval* evals;
+
+/*
+ * report_func - Print function i's outcome for the scored geometry
+ */
+static void report_func(int i, struct func_eval* ev)
+{
+    if (ev->correct)
         printf("func %u (%s): hits:%u, misses:%u, evictions:%u\n",
-               i, func_list[i].description, hits, misses, evictions);
-    
-        /* If it is transpose_submit(), record number of misses */
-        if (results.funcid == i) {
-            results.misses = misses;
+               i, func_list[i].description, ev->perf[0].hits, ev->perf[0].misses, ev->perf[0].evictions);
+    else
+        printf("Validation error at function %d! Run ./tracegen -M %d -N %d -A %ld -F %d for details.\nSkipping performance evaluation for this function.\n", i, M, N, alignment, i);
+}
+
+/*
+ * trace_failed - Report that function i couldn't be traced. Nothing is
+ *     cached, so the next run tries again.
+ */
+static void trace_failed(int i, struct func_eval* ev)
+{
+    ev->correct = 0;
+    printf("Tracing failed at function %d! Run ./tracegen -M %d -N %d -A %ld -F %d for details.\n",
+           i, M, N, alignment, i);
+}
+
+/*
+ * store_result - Cache function i's outcome, one file per geometry. Region
+ *     lines, if any, follow the counts for the scored geometry.
+ */
+static void store_result(int i, struct func_eval* ev, region_table* regions)
+{
+    char path[PATH_MAX + 64], tmp[PATH_MAX + 80];
+    FILE* fp;
+
+    if (!trace_key[i])
+        return;
+    for (int g = 0; g < num_geoms; g++) {
+        result_path(path, i, g);
+        if ((fp = cache_create(path, tmp)) == NULL)
+            return;
+        fprintf(fp, "%d %d %d %d\n", ev->correct, ev->perf[g].hits, ev->perf[g].misses, ev->perf[g].evictions);
+        if (g == 0 && regions)
+            print_regions(fp, regions);
+        cache_commit(fp, tmp, path);
+    }
+}
+
+/*
+ * cached_result - Report function i's cached outcome. Returns 0 unless
+ *     there is one for every geometry.
+ */
+static int cached_result(int i, struct func_eval* out)
+{
+    char path[PATH_MAX + 64], buf[1000];
+    FILE* fp[MAX_GEOMS];
+    int g, found = 1;
+
+    if (!use_cache || !trace_key[i])
+        return 0;
+    for (g = 0; g < num_geoms; g++) {
+        result_path(path, i, g);
+        fp[g] = fopen(path, "r");
+        if (!fp[g] || fscanf(fp[g], "%d %d %d %d\n", &out->correct, &out->perf[g].hits,
+                             &out->perf[g].misses, &out->perf[g].evictions) != 4)
+            found = 0;
+    }
+
+    if (found) {
+        printf("Using cached result %016llx\n", trace_key[i]);
+        report_func(i, out);
+        while (fgets(buf, sizeof(buf), fp[0]) != NULL)
+            fputs(buf, stdout);
+    }
+    for (g = 0; g < num_geoms; g++) {
+        if (fp[g])
+            fclose(fp[g]);
+    }
+    return found;
+}
+
+/*
+ * have_trace - True if function i's window trace is cached
+ */
+static int have_trace(int i)
+{
+    char path[PATH_MAX + 64];
+
+    if (!use_cache || !trace_cached(i))
+        return 0;
+    trace_path(path, i);
+    return access(path, R_OK) == 0;
+}
+
+/*
+ * simulate_func - Run function i's window trace through an in-process
+ *     cache of every geometry in one pass, report it, and cache the
+ *     result. Regions are counted for the scored geometry.
+ */
+static void simulate_func(int i, struct func_eval* out)
+{
+    char path[PATH_MAX + 64], type;
+    region_table regions;
+    int have_regions, g, size;
+    unsigned int address;
+    cache* caches[MAX_GEOMS];
+    location loc;
+    FILE* fp;
+
+    trace_path(path, i);
+    fp = fopen(path, "r");
+    assert(fp);
+    regions_path(path, i);
+    have_regions = load_regions(path, &regions) > 0;
+
+    printf("Step 2: Evaluating performance (");
+    for (g = 0; g < num_geoms; g++)
+        printf("%ss=%d, E=%d, b=%d", g ? "; " : "", geoms[g].s, geoms[g].E, geoms[g].b);
+    printf(")\n");
+
+    memset(out->perf, 0, sizeof(out->perf));
+    for (g = 0; g < num_geoms; g++)
+        setup_cache(&caches[g], geoms[g].s, geoms[g].E, geoms[g].b, 64 - (geoms[g].s + geoms[g].b));
+
+    while (fscanf(fp, " %c %x,%d", &type, &address, &size) == 3) {
+        if (have_regions)
+            simulate_region_access(&regions, &out->perf[0], caches[0], &loc, type, address);
+        else
+            simulate_access(&out->perf[0], caches[0], &loc, type, address);
+        for (g = 1; g < num_geoms; g++)
+            simulate_access(&out->perf[g], caches[g], &loc, type, address);
+    }
+
+    for (g = 0; g < num_geoms; g++)
+        free_cache(&caches[g]);
+    fclose(fp);
+
+    out->correct = 1;
+    report_func(i, out);
+    if (have_regions)
+        print_regions(stdout, &regions);
+    store_result(i, out, have_regions ? &regions : NULL);
+}
+
+/*
+ * eval_func - Trace function i, validate it, and simulate its accesses.
+ *     Runs in the current directory, which holds trace.tmp and .marker.
+ *     A cached result or trace for the same code is used instead when
+ *     there is one.
+ */
+static void eval_func(int i, struct func_eval* out)
+{
+    int status, n;
+    struct marker* markers;
+    char* want;
+    char cmd[PATH_MAX + 255];
+
+    memset(out, 0, sizeof(*out));
+
+    printf("\nFunction %d (%d total)\n", i, func_counter);
+    if (func_list[i].params || func_list[i].tags || func_list[i].generated)
+        printf("Info: params:%s tags:%s%s\n", func_list[i].params ? func_list[i].params : "-",
+               func_list[i].tags ? func_list[i].tags : "-", func_list[i].generated ? " (generated)" : "");
+    if (cached_result(i, out))
+        return;
+
+    if (have_trace(i)) {
+        printf("Step 1: Using cached trace %016llx\n", trace_key[i]);
+        simulate_func(i, out);
+        return;
+    }
+
+    printf("Step 1: Validating and generating memory traces\n");
+    unlink(CL_REGION_FILE);
+    unlink(".marker");
+    unlink("trace.tmp");
+    /* Use valgrind, or the compiler-instrumented tracegen-cap, to generate the trace */
+    if (capture)
+        sprintf(cmd, "%s/tracegen-cap -M %d -N %d -A %ld -F %d > trace.tmp", tool_dir, M, N, alignment, i);
+    else
+        sprintf(cmd, "valgrind --tool=lackey --trace-mem=yes --log-fd=1 -v %s/tracegen -M %d -N %d -A %ld -F %d  > trace.tmp", tool_dir, M, N, alignment, i);
+    status = system(cmd);
+
+    /* tracegen writes .marker last, so a tracer that died has none */
+    markers = calloc(func_counter, sizeof(struct marker));
+    want = calloc(func_counter, 1);
+    assert(markers && want);
+    n = read_markers(markers);
+    if (n <= i || !WIFEXITED(status)) {
+        trace_failed(i, out);
+        free(markers);
+        free(want);
+        return;
+    }
+    if (0!=WEXITSTATUS(status)) {
+        free(markers);
+        free(want);
+        printf("Validation error at function %d! Run ./tracegen -M %d -N %d -A %ld -F %d for details.\nSkipping performance evaluation for this function.\n",i,M,N,alignment,i);      
+        store_result(i, out, NULL);
+        return;
+    }
+
+    /* Keep this function's window */
+    want[i] = 1;
+    store_windows(markers, n, want);
+    if (markers[i].closed)
+        simulate_func(i, out);
+    else
+        trace_failed(i, out);
+    free(markers);
+    free(want);
+}
+
+/*
+ * record_eval - Store the outcome of function i
+ */
+static void record_eval(int i, struct func_eval* ev)
+{
+    evals[i] = *ev;
+    func_list[i].correct = ev->correct;
+    func_list[i].num_hits = ev->perf[0].hits;
+    func_list[i].num_misses = ev->perf[0].misses;
+    func_list[i].num_evictions = ev->perf[0].evictions;
+
+    /* Save the correctness and misses of the transpose submission */
+    if (results.funcid == i && ev->correct) {
+        results.correct = 1;
+        results.misses = ev->perf[0].misses;
+    }
+}
+
+/*
+ * run_pool - Run work(k, &ev) for k = 0..count-1, each in its own child
+ *     process, at most jobs at a time. Each child works in its own
+ *     directory under WORK_DIR, so trace.tmp and .marker are never shared,
+ *     writes its output to a log there, and sends ev back through a pipe.
+ *     report(k, &ev, log) is called in order of k as children finish.
+ */
+static void run_pool(int count, void (*work)(int, struct func_eval*),
+                     void (*report)(int, struct func_eval*, FILE*))
+{
+    pid_t* pids = calloc(count, sizeof(pid_t));
+    int* pipes = calloc(count, sizeof(int));
+    char* done = calloc(count, 1);
+    char dir[PATH_MAX], path[PATH_MAX + 16];
+    int next_start = 0, next_report = 0, running = 0;
+
+    assert(pids && pipes && done);
+    mkdir(WORK_DIR, 0755);
+
+    while (next_report < count) {
+        /* Keep the pool full */
+        while (running < jobs && next_start < count) {
+            int k = next_start++, fds[2];
+            assert(pipe(fds) == 0);
+            sprintf(dir, "%s/w%d", WORK_DIR, k);
+            mkdir(dir, 0755);
+
+            /* Reported output must not be buffered twice */
+            fflush(stdout);
+            if ((pids[k] = fork()) == 0) {
+                struct func_eval ev;
+                struct dirent* de;
+                DIR* d;
+
+                close(fds[0]);
+                if (chdir(dir) != 0 || freopen("log", "w", stdout) == NULL)
+                    _exit(1);
+                work(k, &ev);
+                fflush(stdout);
+
+                /* Leave only the log behind */
+                if ((d = opendir(".")) != NULL) {
+                    while ((de = readdir(d)) != NULL) {
+                        if (strcmp(de->d_name, "log") != 0)
+                            unlink(de->d_name);
+                    }
+                    closedir(d);
+                }
+                if (write(fds[1], &ev, sizeof(ev)) != sizeof(ev))
+                    _exit(1);
+                _exit(0);
+            }
+            assert(pids[k] > 0);
+            close(fds[1]);
+            pipes[k] = fds[0];
+            running++;
+        }
+
+        /* Wait for any child, then report everything that is now in order */
+        pid_t pid = wait(NULL);
+        for (int k = 0; k < next_start; k++) {
+            if (pids[k] == pid) {
+                done[k] = 1;
+                running--;
+            }
+        }
+
+        while (next_report < count && done[next_report]) {
+            int k = next_report++;
+            struct func_eval ev;
+
+            if (read(pipes[k], &ev, sizeof(ev)) != sizeof(ev))
+                memset(&ev, 0, sizeof(ev));
+            close(pipes[k]);
+
+            sprintf(dir, "%s/w%d", WORK_DIR, k);
+            sprintf(path, "%s/log", dir);
+            FILE* log_fp = fopen(path, "r");
+            report(k, &ev, log_fp);
+            if (log_fp)
+                fclose(log_fp);
+            unlink(path);
+            rmdir(dir);
         }
     }
-  
+
+    rmdir(WORK_DIR);
+    free(pids);
+    free(pipes);
+    free(done);
+}
+
+/*
+ * eval_selected - Evaluate the k-th selected function
+ */
+static void eval_selected(int k, struct func_eval* ev)
+{
+    eval_func(sel[k], ev);
+}
+
+/*
+ * report_parallel - Pass on the k-th selected function's log and record
+ *     its outcome
+ */
+static void report_parallel(int k, struct func_eval* ev, FILE* log_fp)
+{
+    char buf[1000];
+
+    if (log_fp) {
+        while (fgets(buf, sizeof(buf), log_fp) != NULL)
+            fputs(buf, stdout);
+    }
+    record_eval(sel[k], ev);
+}
+
+/*
+ * eval_parallel - Evaluate every selected function in its own child
+ *     process, at most jobs at a time. Logs and results are reported in
+ *     function order.
+ */
+static void eval_parallel(void)
+{
+    run_pool(num_sel, eval_selected, report_parallel);
+}
+
+/*
+ * eval_single_run - Trace all functions in one run of tracegen and split
+ *     the trace into per-function windows in one pass, so valgrind only
+ *     starts once. Functions that fail validation are still traced but
+ *     are not scored. The run is skipped entirely if every selected
+ *     function has a cached result or trace.
+ */
+static void eval_single_run(void)
+{
+    struct marker* markers = calloc(func_counter, sizeof(struct marker));
+    struct func_eval* ev = calloc(func_counter, sizeof(struct func_eval));
+    char* want = calloc(func_counter, 1);
+    char* cached = calloc(func_counter, 1);
+    char cmd[PATH_MAX + 255];
+    int i, k, n = 0, need_trace = 0, status;
+
+    assert(markers && ev && want && cached);
+    printf("\nAll functions (%d selected of %d)\n", num_sel, func_counter);
+    for (k = 0; k < num_sel; k++) {
+        i = sel[k];
+        cached[i] = cached_result(i, &ev[i]);
+        want[i] = !cached[i] && !have_trace(i);
+        need_trace |= want[i];
+    }
+
+    if (need_trace) {
+        printf("Step 1: Validating and generating memory traces\n");
+        unlink(CL_REGION_FILE);
+        unlink(".marker");
+        unlink("trace.tmp");
+        if (capture)
+            sprintf(cmd, "%s/tracegen-cap -M %d -N %d -A %ld > trace.tmp", tool_dir, M, N, alignment);
+        else
+            sprintf(cmd, "valgrind --tool=lackey --trace-mem=yes --log-fd=1 -v %s/tracegen -M %d -N %d -A %ld > trace.tmp", tool_dir, M, N, alignment);
+        status = system(cmd);
+
+        /* tracegen writes .marker last, so a tracer that died has none */
+        n = read_markers(markers);
+        if (n < 0 || !WIFEXITED(status)) {
+            printf("Tracing failed! Run ./tracegen -M %d -N %d -A %ld for details.\n", M, N, alignment);
+            goto out;
+        }
+        for (i = 0; i < func_counter; i++)
+            want[i] = want[i] && i < n && markers[i].valid == 1;
+        store_windows(markers, n, want);
+    }
+
+    for (k = 0; k < num_sel; k++) {
+        i = sel[k];
+        if (cached[i]) {
+            record_eval(i, &ev[i]);
+            continue;
+        }
+        if (want[i] && !markers[i].closed) {
+            trace_failed(i, &ev[i]);
+        } else if (want[i] || have_trace(i)) {
+            simulate_func(i, &ev[i]);
+        } else {
+            report_func(i, &ev[i]);
+            store_result(i, &ev[i], NULL);
+        }
+        record_eval(i, &ev[i]);
+    }
+
+out:
+    free(markers);
+    free(ev);
+    free(want);
+    free(cached);
+}
+
+/*
+ * sweep_shape - The M and N of shape k of the sweep, in row major order
+ *     over (N, M)
+ */
+static void sweep_shape(int k, int* m, int* n)
+{
+    int m_count = (m_range.hi - m_range.lo) / m_range.step + 1;
+    *m = m_range.lo + (k % m_count) * m_range.step;
+    *n = n_range.lo + (k / m_count) * n_range.step;
+}
+
+/* The function being swept (the submission unless -n or -t pick another),
+   and its misses for each shape of the sweep, -1 if invalid */
+static int sweep_func = -1;
+static int* sweep_misses;
+
+/*
+ * eval_shape - Evaluate the swept function on shape k. Its trace
+ *     is not kept, since a sweep visits far too many shapes to store them.
+ */
+static void eval_shape(int k, struct func_eval* ev)
+{
+    char path[PATH_MAX + 64];
+    int i = sweep_func;
+
+    sweep_shape(k, &M, &N);
+    key_functions();
+    eval_func(i, ev);
+    trace_path(path, i);
+    unlink(path);
+    regions_path(path, i);
+    unlink(path);
+}
+
+/*
+ * report_shape - Record the outcome of shape k of the sweep
+ */
+static void report_shape(int k, struct func_eval* ev, FILE* log_fp)
+{
+    sweep_misses[k] = ev->correct ? ev->perf[0].misses : -1;
+    fprintf(stderr, "\rEvaluated shape %d", k + 1);
+}
+
+/*
+ * eval_sweep - Evaluate the swept function on every shape in the M and N
+ *     ranges, jobs at a time (one per core by default), and print its
+ *     misses per matrix element as a surface over M and N, followed by
+ *     the shapes where it does worst
+ */
+static void eval_sweep(void)
+{
+    int m_count = (m_range.hi - m_range.lo) / m_range.step + 1;
+    int n_count = (n_range.hi - n_range.lo) / n_range.step + 1;
+    int count = m_count * n_count, k, m, n;
+    int worst[10], num_worst = 0;
+
+    if (sweep_func == -1)
+        return;
+    if (jobs == 0)
+        jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    sweep_misses = calloc(count, sizeof(int));
+    assert(sweep_misses);
+
+    printf("Sweeping %d shapes of func %d (%s) on s=%d, E=%d, b=%d\n", count, sweep_func,
+           func_list[sweep_func].description, geoms[0].s, geoms[0].E, geoms[0].b);
+    fflush(stdout);
+    run_pool(count, eval_shape, report_shape);
+    fprintf(stderr, "\n");
+
+    printf("\nMisses per element (rows N, columns M):\n%5s", "N\\M");
+    for (k = 0; k < m_count; k++)
+        printf(" %6d", m_range.lo + k * m_range.step);
+    printf("\n");
+    for (k = 0; k < count; k++) {
+        sweep_shape(k, &m, &n);
+        if (k % m_count == 0)
+            printf("%5d", n);
+        if (sweep_misses[k] < 0)
+            printf(" %6s", "-");
+        else
+            printf(" %6.3f", (double) sweep_misses[k] / (m * n));
+        if (k % m_count == m_count - 1)
+            printf("\n");
+    }
+
+    /* Keep the ten worst shapes by misses per element, worst first */
+    for (k = 0; k < count; k++) {
+        int j;
+        double mpe;
+
+        if (sweep_misses[k] < 0)
+            continue;
+        sweep_shape(k, &m, &n);
+        mpe = (double) sweep_misses[k] / (m * n);
+        for (j = num_worst; j > 0; j--) {
+            int m2, n2;
+            sweep_shape(worst[j - 1], &m2, &n2);
+            if ((double) sweep_misses[worst[j - 1]] / (m2 * n2) >= mpe)
+                break;
+            if (j < 10)
+                worst[j] = worst[j - 1];
+        }
+        if (j < 10) {
+            worst[j] = k;
+            if (num_worst < 10)
+                num_worst++;
+        }
+    }
+
+    printf("\nWorst shapes:\n");
+    for (k = 0; k < num_worst; k++) {
+        sweep_shape(worst[k], &m, &n);
+        printf("M=%d N=%d: misses:%d, per element:%.3f\n", m, n, sweep_misses[worst[k]],
+               (double) sweep_misses[worst[k]] / (m * n));
+    }
+    for (k = 0; k < count; k++) {
+        if (sweep_misses[k] < 0) {
+            sweep_shape(k, &m, &n);
+            printf("Validation error at M=%d N=%d\n", m, n);
+        }
+    }
+    free(sweep_misses);
+}
+
+/*
+ * print_matrix - Print every function's misses on every geometry
+ */
+static void print_matrix(void)
+{
+    char label[32];
+    int i, g;
+
+    printf("\nMisses by function and geometry (s:E:b):\n%-6s", "func");
+    for (g = 0; g < num_geoms; g++) {
+        sprintf(label, "%u:%u:%u", geoms[g].s, geoms[g].E, geoms[g].b);
+        printf(" %10s", label);
+    }
+    printf("\n");
+
+    for (int k = 0; k < num_sel; k++) {
+        i = sel[k];
+        printf("%-6d", i);
+        for (g = 0; g < num_geoms; g++) {
+            if (evals[i].correct)
+                printf(" %10d", evals[i].perf[g].misses);
+            else
+                printf(" %10s", "-");
+        }
+        printf("  %s\n", func_list[i].description);
+    }
+}
+
+/* 
+ * eval_perf - Evaluate the performance of the registered transpose functions
+ *     on a cache with the scored geometry (s, E, b) and on every geometry
+ *     given with -g
+ */
+void eval_perf(unsigned int s, unsigned int E, unsigned int b)
+{
+    int i, num_other_size = 0;
+    struct func_eval ev;
+    char path[PATH_MAX + 16];
+
+    geoms[0].s = s;
+    geoms[0].E = E;
+    geoms[0].b = b;
+
+    registerFunctions(); 
+    if (registerGeneratedFunctions)
+        registerGeneratedFunctions();
+    evals = calloc(func_counter, sizeof(struct func_eval));
+    assert(evals || func_counter == 0);
+
+    /* Select the functions to evaluate. Generated kernels for other sizes
+       would only run their correctTrans fallback, so they are left out. */
+    sel = calloc(func_counter, sizeof(int));
+    assert(sel || func_counter == 0);
+    for (i = 0; i < func_counter; i++) {
+        if (name_filter && fnmatch(name_filter, func_list[i].description, 0) != 0)
+            continue;
+        if (tag_filter && !transFunctionHasTag(i, tag_filter))
+            continue;
+        if (!sweeping && !transFunctionFitsSize(i, M, N)) {
+            num_other_size++;
+            continue;
+        }
+        sel[num_sel++] = i;
+    }
+    if (num_other_size > 0)
+        printf("Skipping %d generated kernels made for other sizes\n", num_other_size);
+
+    /* Remember which function is the submission */
+    for (i=0; i<func_counter; i++) {
+        if (strcmp(func_list[i].description, SUBMIT_DESCRIPTION) == 0 )
+            results.funcid = i;
+    }
+    if (sweeping)
+        sweep_func = (name_filter || tag_filter) && num_sel > 0 ? sel[0] : results.funcid;
+
+    /* Key every function (only the swept one in a sweep) by its code, for
+       the result cache */
+    hash_code(sweeping ? sweep_func : -1);
+    key_functions();
+    sprintf(path, "%s/%s", tool_dir, CACHE_DIR);
+    mkdir(path, 0755);
+
+    if (sweeping) {
+        eval_sweep();
+        return;
+    } else if (single_run) {
+        eval_single_run();
+    } else if (jobs > 1) {
+        eval_parallel();
+    } else {
+        /* Evaluate the performance of each selected transpose function */
+        for (int k = 0; k < num_sel; k++) {
+            eval_func(sel[k], &ev);
+            record_eval(sel[k], &ev);
+        }
+    }
+
+    if (num_geoms > 1)
+        print_matrix();
+}
+
+/*
+ * parse_range - Parse a matrix dimension, either a single value or a
+ *     lo:hi[:step] range. Returns -1 if it is malformed.
+ */
+static int parse_range(char* arg, struct range* r)
+{
+    int fields = sscanf(arg, "%d:%d:%d", &r->lo, &r->hi, &r->step);
+
+    if (fields == 1)
+        r->hi = r->lo;
+    if (fields < 3)
+        r->step = 1;
+    if (r->lo < 1 || r->hi < r->lo || r->step < 1)
+        return -1;
+    return 0;
+}
+
+/*
+ * parse_geometries - Add the comma separated s:E:b geometries in list, or
+ *     the STANDARD_GEOMETRIES for "standard", to the ones evaluated.
+ *     Returns -1 if one is malformed or there are too many.
+ */
+static int parse_geometries(char* list)
+{
+    char standard[] = STANDARD_GEOMETRIES;
+    char* tok;
+    int s, E, b;
+
+    if (strcmp(list, "standard") == 0)
+        list = standard;
+    for (tok = strtok(list, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        if (sscanf(tok, "%d:%d:%d", &s, &E, &b) != 3 || s < 0 || E < 1 || b < 0 ||
+            s + b > 63 || num_geoms == MAX_GEOMS)
+            return -1;
+        geoms[num_geoms].s = s;
+        geoms[num_geoms].E = E;
+        geoms[num_geoms].b = b;
+        num_geoms++;
+    }
+    return 0;
+}
+
+/*
+ * submission_selected - True if the filters kept the official submission
+ */
+static int submission_selected(void)
+{
+    for (int k = 0; k < num_sel; k++) {
+        if (sel[k] == results.funcid)
+            return 1;
+    }
+    return 0;
 }
 
 /*
  * usage - Print usage info
  */
 void usage(char *argv[]){
-    printf("Usage: %s [-h] -M <rows> -N <cols>\n", argv[0]);
+    printf("Usage: %s [-hcaf] [-j <jobs>] [-g <s:E:b,...>] [-n <pattern>] [-t <tag>] [-A <bytes>]\n"
+           "       -M <rows>|<lo:hi[:step]> -N <cols>|<lo:hi[:step]>\n", argv[0]);
     printf("Options:\n");
     printf("  -h          Print this help message.\n");
+    printf("  -c          Trace with ./tracegen-cap instead of valgrind.\n");
+    printf("  -j <jobs>   Evaluate functions in parallel (0 = one per core).\n");
+    printf("  -a          Trace all functions in a single run of tracegen.\n");
+    printf("  -f          Re-evaluate every function, ignoring cached results.\n");
+    printf("  -n <pattern> Only evaluate functions whose description matches this glob.\n");
+    printf("  -t <tag>    Only evaluate functions with this tag.\n");
+    printf("  -g <list>   Also simulate these s:E:b geometries (or \"standard\") and print a misses matrix\n");
+    printf("              (up to %d, e.g. 6:8:6 is 32 KiB 8-way with 64 B lines).\n", MAX_GEOMS - 1);
+    printf("  -A <bytes>  Map the matrices at this alignment in tracegen instead of using\n");
+    printf("              the lab's static ones (sizes above 256 are always mapped).\n");
     printf("  -M <rows>   Number of matrix rows (max %d)\n", MAXN);
     printf("  -N <cols>   Number of  matrix columns (max %d)\n", MAXN);
+    printf("              Either may be a lo:hi[:step] range, which sweeps every\n");
+    printf("              shape in the ranges and prints misses per element.\n");
     printf("Example: %s -M 8 -N 8\n", argv[0]);       
+    printf("         %s -c -M 8:256:8 -N 8:256:8\n", argv[0]);
 }
 
 /*
@@ -199,13 +1382,58 @@ int main(int argc, char* argv[])
 {
     char c;
 
-    while ((c = getopt(argc,argv,"M:N:h")) != -1) {
+    while ((c = getopt(argc,argv,"M:N:A:hcj:afg:n:t:")) != -1) {
         switch(c) {
+        case 'c':
+            capture = 1;
+            break;
+        case 'a':
+            single_run = 1;
+            break;
+        case 'f':
+            use_cache = 0;
+            break;
+        case 'n':
+            name_filter = optarg;
+            break;
+        case 't':
+            tag_filter = optarg;
+            break;
+        case 'g':
+            if (parse_geometries(optarg) < 0) {
+                printf("Error: Invalid geometry list \"%s\"\n", optarg);
+                usage(argv);
+                exit(1);
+            }
+            break;
+        case 'j':
+            jobs = atoi(optarg);
+            if (jobs <= 0)
+                jobs = sysconf(_SC_NPROCESSORS_ONLN);
+            break;
         case 'M':
-            M = atoi(optarg);
+            if (parse_range(optarg, &m_range) < 0) {
+                printf("Error: Invalid size \"%s\"\n", optarg);
+                usage(argv);
+                exit(1);
+            }
+            M = m_range.lo;
             break;
         case 'N':
-            N = atoi(optarg);
+            if (parse_range(optarg, &n_range) < 0) {
+                printf("Error: Invalid size \"%s\"\n", optarg);
+                usage(argv);
+                exit(1);
+            }
+            N = n_range.lo;
+            break;
+        case 'A':
+            alignment = atol(optarg);
+            if (alignment <= 0 || (alignment & (alignment - 1)) != 0) {
+                printf("Error: Alignment must be a power of two\n");
+                usage(argv);
+                exit(1);
+            }
             break;
         case 'h':
             usage(argv);
@@ -222,7 +1450,7 @@ int main(int argc, char* argv[])
         exit(1);
     }
 
-    if (M > MAXN || N > MAXN) {
+    if (m_range.hi > MAXN || n_range.hi > MAXN) {
         printf("Error: M or N exceeds %d\n", MAXN);
         usage(argv);
         exit(1);
@@ -239,11 +1467,21 @@ int main(int argc, char* argv[])
         exit(1);
     }
 
-    /* Time out and give up after a while */
-    alarm(120);
+    if (getcwd(tool_dir, sizeof(tool_dir)) == NULL) {
+        fprintf(stderr, "Unable to get the current directory\n");
+        exit(1);
+    }
+
+    /* Time out and give up after a while, unless sweeping many shapes or
+       tracing matrices bigger than the lab's, which can take much longer */
+    sweeping = m_range.lo != m_range.hi || n_range.lo != n_range.hi;
+    if (!sweeping && M <= 256 && N <= 256)
+        alarm(120);
 
     /* Check the performance of the student's transpose function */
     eval_perf(5, 1, 5);
+    if (sweeping && results.funcid != -1)
+        return 0;
   
     /* Emit the results for this particular test */
     if (results.funcid == -1) {
@@ -252,6 +1490,9 @@ int main(int argc, char* argv[])
                SUBMIT_DESCRIPTION);
         printf("\nTEST_TRANS_RESULTS=0:0\n");
     }
+    else if (!submission_selected()) {
+        printf("\nThe official submission (func %d) was not selected by -n/-t\n", results.funcid);
+    }
     else {
         printf("\nSummary for official submission (func %d): correctness=%d misses=%d\n",
                results.funcid, results.correct, results.misses);
@@ -0,0 +1,125 @@
+/*
+ * tracecap.c - In-process memory tracer that replaces valgrind for
+ *     transpose evaluation.
+ *
+ * tracegen.c and trans.c are compiled with -fsanitize=thread, which makes
+ * the compiler call __tsan_readN/__tsan_writeN before every memory
+ * access. Instead of linking the ThreadSanitizer runtime, tracegen-cap
+ * links this file, which implements those callbacks by recording the
+ * accesses made between a store to a function's start marker and a store
+ * to its end marker into an in-memory buffer. When an end marker is written,
+ * the buffer is printed in the same format as valgrind's lackey tool, so
+ * test-trans can filter and simulate it exactly like a valgrind trace.
+ *
+ * Only accesses below 4GB are kept, which is the same filter test-trans
+ * applies. tracegen-cap is linked with -no-pie so that its globals, like
+ * valgrind's, live in the low 4GB and the stack does not.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "cachelab.h"
+
+/* Per-function markers defined in tracegen.c */
+extern volatile char* MARKERS;
+extern int MARKER_COUNT;
+
+typedef struct cap_access {
+    unsigned long long addr;
+    unsigned int size;
+    char type;
+} cap_access;
+
+static cap_access *cap_buf = NULL;
+static size_t cap_count = 0, cap_size = 0;
+static int capturing = 0;
+
+/*
+ * cap_flush - Write the captured window to stdout in lackey format
+ */
+static void cap_flush(void)
+{
+    for (size_t i = 0; i < cap_count; i++)
+        printf(" %c %08llx,%u\n", cap_buf[i].type, cap_buf[i].addr, cap_buf[i].size);
+    fflush(stdout);
+    cap_count = 0;
+}
+
+/*
+ * marker_kind - 1 if p is a start marker, 2 if it is an end marker, else 0
+ */
+static int marker_kind(void *p)
+{
+    uintptr_t d = (uintptr_t) p - (uintptr_t) MARKERS;
+
+    if (MARKERS == NULL || (uintptr_t) p < (uintptr_t) MARKERS ||
+        d >= (uintptr_t) MARKER_COUNT * MARKER_STRIDE)
+        return 0;
+    d %= MARKER_STRIDE;
+    return d == 0 ? 1 : d == 1 ? 2 : 0;
+}
+
+/*
+ * cap_record - Record one access if it falls inside a marker window
+ */
+static void cap_record(char type, void *p, unsigned int size)
+{
+    unsigned long long addr = (unsigned long long) (uintptr_t) p;
+    int kind = marker_kind(p);
+
+    if (kind == 1)
+        capturing = 1;
+    if (!capturing)
+        return;
+
+    if (addr < 0xffffffff) {
+        if (cap_count == cap_size) {
+            cap_size = cap_size ? 2 * cap_size : 1 << 16;
+            cap_buf = realloc(cap_buf, cap_size * sizeof(cap_access));
+            if (cap_buf == NULL) {
+                fprintf(stderr, "tracecap: out of memory\n");
+                exit(1);
+            }
+        }
+        cap_buf[cap_count].addr = addr;
+        cap_buf[cap_count].size = size;
+        cap_buf[cap_count].type = type;
+        cap_count++;
+    }
+
+    if (kind == 2) {
+        capturing = 0;
+        cap_flush();
+    }
+}
+
+/*
+ * The compiler-inserted callbacks. Function entry/exit and init hooks
+ * are required by the instrumentation but have nothing to record.
+ */
+void __tsan_init(void) {}
+void __tsan_func_entry(void *pc) {}
+void __tsan_func_exit(void) {}
+
+void __tsan_read1(void *p) { cap_record('L', p, 1); }
+void __tsan_read2(void *p) { cap_record('L', p, 2); }
+void __tsan_read4(void *p) { cap_record('L', p, 4); }
+void __tsan_read8(void *p) { cap_record('L', p, 8); }
+void __tsan_read16(void *p) { cap_record('L', p, 16); }
+void __tsan_write1(void *p) { cap_record('S', p, 1); }
+void __tsan_write2(void *p) { cap_record('S', p, 2); }
+void __tsan_write4(void *p) { cap_record('S', p, 4); }
+void __tsan_write8(void *p) { cap_record('S', p, 8); }
+void __tsan_write16(void *p) { cap_record('S', p, 16); }
+
+void __tsan_unaligned_read2(void *p) { cap_record('L', p, 2); }
+void __tsan_unaligned_read4(void *p) { cap_record('L', p, 4); }
+void __tsan_unaligned_read8(void *p) { cap_record('L', p, 8); }
+void __tsan_unaligned_read16(void *p) { cap_record('L', p, 16); }
+void __tsan_unaligned_write2(void *p) { cap_record('S', p, 2); }
+void __tsan_unaligned_write4(void *p) { cap_record('S', p, 4); }
+void __tsan_unaligned_write8(void *p) { cap_record('S', p, 8); }
+void __tsan_unaligned_write16(void *p) { cap_record('S', p, 16); }
+
+void __tsan_read_range(void *p, unsigned long size) { cap_record('L', p, (unsigned int) size); }
+void __tsan_write_range(void *p, unsigned long size) { cap_record('S', p, (unsigned int) size); }
@@ -3,42 +3,117 @@
  * a memory trace of all of the registered transpose functions. 
  * 
  * The beginning and end of each registered transpose function's trace
- * is indicated by reading from "marker" addresses. These two marker
- * addresses are recorded in file for later use.
+ * is indicated by writing to "marker" addresses. Every function has its
+ * own pair of markers, so a single traced run of all functions can be
+ * split into per-function windows. The pairs are MARKER_STRIDE apart and
+ * sit in the cache line before A's, at the same page offset, so that each
+ * function's window sees the markers exactly as the lab's single pair
+ * was seen. The marker pairs are recorded in .marker for later use, one
+ * line per function:
+ *
+ *     <start marker> <end marker> <valid>
+ *
+ * where valid is 1 if the function produced a correct transpose, 0 if
+ * it did not, and -1 if it was not run.
+ *
+ * Matrices of up to 256x256 live in static arrays, B right after A, as
+ * in the lab's tracegen, so that miss counts match the graded ones.
+ * Bigger matrices, or any size with -A <alignment>, are mapped instead,
+ * below 2GB so that the tracers (which drop addresses above 4GB) still
+ * see their accesses.
  */
 
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <assert.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <sys/mman.h>
 #include "cachelab.h"
 #include <string.h>
 
 /* External variables declared in cachelab.c */
-extern trans_func_t func_list[MAX_TRANS_FUNCS];
+extern trans_func_t* func_list;
 extern int func_counter; 
 
 /* External function from trans.c */
 extern void registerFunctions();
 
-/* Markers used to bound trace regions of interest */
-volatile char MARKER_START, MARKER_END;
+/* Markers used to bound trace regions of interest: function i's start
+   marker is MARKERS[i * MARKER_STRIDE], and its end marker the byte after */
+volatile char* MARKERS;
+int MARKER_COUNT;
+
+/* The largest matrices the tracers can handle: both must fit below 2GB */
+#define MAXN 8192
 
 static int A[256][256];
 static int B[256][256];
 static int M;
 static int N;
 
+/* Where the matrices actually are: A and B above, or a mapping */
+static int* matrix_a;
+static int* matrix_b;
+
+
+/*
+ * alloc_matrices - Point matrix_a and matrix_b at room for the matrices.
+ *     With alignment 0 a matrix that fits uses the static arrays; any
+ *     other matrix is mapped with B after A, both starting on a multiple
+ *     of the alignment (a power of two, 64 if 0). Returns -1 if there is
+ *     no room below 2GB.
+ */
+static int alloc_matrices(int M, int N, size_t alignment) {
+    size_t bytes = sizeof(int) * (size_t) M * N, stride;
+    uintptr_t base;
+    void* map;
+
+    if (alignment == 0 && M <= 256 && N <= 256) {
+        matrix_a = &A[0][0];
+        matrix_b = &B[0][0];
+        return 0;
+    }
+    if (alignment == 0)
+        alignment = 64;
+
+    stride = (bytes + alignment - 1) & ~(alignment - 1);
+    map = mmap(NULL, 2 * stride + alignment, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (map == MAP_FAILED)
+        return -1;
+    base = ((uintptr_t) map + alignment - 1) & ~(uintptr_t) (alignment - 1);
+    matrix_a = (int*) base;
+    matrix_b = (int*) (base + stride);
+    return 0;
+}
+
+/*
+ * alloc_markers - Map a marker pair for each of the count functions, below
+ *     2GB like the matrices. Returns -1 if there is no room.
+ */
+static int alloc_markers(int count) {
+    size_t offset = ((uintptr_t) matrix_a - 32) & (MARKER_STRIDE - 1);
+    void* map = mmap(NULL, (size_t) count * MARKER_STRIDE + MARKER_STRIDE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (map == MAP_FAILED)
+        return -1;
+    MARKERS = (volatile char*) map + offset;
+    MARKER_COUNT = count;
+    return 0;
+}
 
+/*
+ * validate - Check B against A directly, element by element, so that no
+ *     copy of the matrix is needed however big it is
+ */
 int validate(int fn,int M, int N, int A[N][M], int B[M][N]) {
-    int C[M][N];
-    memset(C,0,sizeof(C));
-    correctTrans(M,N,A,C);
     for(int i=0;i<M;i++) {
         for(int j=0;j<N;j++) {
-            if(B[i][j]!=C[i][j]) {
-                printf("Validation failed on function %d! Expected %d but got %d at B[%d][%d]\n",fn,C[i][j],B[i][j],i,j);
+            if(B[i][j]!=A[j][i]) {
+                printf("Validation failed on function %d! Expected %d but got %d at B[%d][%d]\n",fn,A[j][i],B[i][j],i,j);
                 return 0;
             }
         }
@@ -46,12 +121,77 @@ int validate(int fn,int M, int N, int A[N][M], int B[M][N]) {
     return 1;
 }
 
+/*
+ * validate_inplace - Check that in-place function fn left the transpose
+ *     of A[i][j] = i*M+j, M rows by N columns, where A was
+ */
+static int validate_inplace(int fn, int M, int N, int R[M][N]) {
+    for(int j=0;j<M;j++) {
+        for(int i=0;i<N;i++) {
+            if(R[j][i]!=i*M+j) {
+                printf("Validation failed on function %d! Expected %d but got %d at A^T[%d][%d]\n",fn,i*M+j,R[j][i],j,i);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/*
+ * run_function - Run function fn in its own marker window and check its
+ *     result. An in-place function first gets A[i][j] = i*M+j, so that
+ *     its result can be checked without a copy of A. Any other function
+ *     first gets B filled with -1, which A never holds, so that it can't
+ *     pass on what an earlier function left in B.
+ */
+static int run_function(int fn) {
+    /* Look the function, its markers and the matrices up outside its window */
+    void (*trans)(int M, int N, int[N][M], int[M][N]) = func_list[fn].func_ptr;
+    void (*inplace)(int M, int N, int[N][M]) = func_list[fn].inplace_ptr;
+    volatile char* start = MARKERS + (long) fn * MARKER_STRIDE;
+    volatile char* end = start + 1;
+    void *a = matrix_a, *b = matrix_b;
+
+    if (inplace) {
+        for (long k = 0; k < (long) M * N; k++)
+            matrix_a[k] = (int) k;
+        *start = 33;
+        (*inplace)(M, N, a);
+        *end = 34;
+        return validate_inplace(fn,M,N,a);
+    }
+    for (long k = 0; k < (long) M * N; k++)
+        matrix_b[k] = -1;
+    *start = 33;
+    (*trans)(M, N, a, b);
+    *end = 34;
+    return validate(fn,M,N,a,b);
+}
+
+/*
+ * write_markers - Record every function's marker pair and validity
+ */
+static void write_markers(int* valid) {
+    FILE* marker_fp = fopen(".marker","w");
+    assert(marker_fp);
+    for (int i = 0; i < func_counter; i++) {
+        fprintf(marker_fp, "%llx %llx %d\n",
+                (unsigned long long int) (uintptr_t) (MARKERS + (long) i * MARKER_STRIDE),
+                (unsigned long long int) (uintptr_t) (MARKERS + (long) i * MARKER_STRIDE + 1),
+                valid[i]);
+    }
+    fclose(marker_fp);
+}
+
 int main(int argc, char* argv[]){
     int i;
+    int status = 0;
 
     char c;
     int selectedFunc=-1;
-    while( (c=getopt(argc,argv,"M:N:F:")) != -1){
+    int print_bases=0;
+    long alignment=0;
+    while( (c=getopt(argc,argv,"M:N:F:A:m")) != -1){
         switch(c){
         case 'M':
             M = atoi(optarg);
@@ -62,6 +202,12 @@ int main(int argc, char* argv[]){
         case 'F':
             selectedFunc = atoi(optarg);
             break;
+        case 'A':
+            alignment = atol(optarg);
+            break;
+        case 'm':
+            print_bases = 1;
+            break;
         case '?':
         default:
             printf("./tracegen failed to parse its options.\n");
@@ -70,38 +216,65 @@ int main(int argc, char* argv[]){
     }
   
 
+    if (M < 0 || N < 0 || M > MAXN || N > MAXN) {
+        printf("./tracegen: M and N must be between 0 and %d\n", MAXN);
+        exit(1);
+    }
+    if (alignment < 0 || (alignment & (alignment - 1)) != 0) {
+        printf("./tracegen: alignment must be a power of two\n");
+        exit(1);
+    }
+    if (alloc_matrices(M, N, alignment) < 0) {
+        printf("./tracegen: no room for %dx%d matrices below 2GB\n", M, N);
+        exit(1);
+    }
+    if (print_bases) {
+        /* Print the matrix bases, e.g. for a loopgen description */
+        printf("A %p B %p\n", (void*) matrix_a, (void*) matrix_b);
+        exit(0);
+    }
+
     /*  Register transpose functions */
     registerFunctions();
+    if (registerGeneratedFunctions)
+        registerGeneratedFunctions();
+    if (alloc_markers(func_counter) < 0) {
+        printf("./tracegen: no room for markers below 2GB\n");
+        exit(1);
+    }
 
     /* Fill A with data */
-    initMatrix(M,N, A, B); 
+    initMatrix(M,N, (void*) matrix_a, (void*) matrix_b); 
 
-    /* Record marker addresses */
-    FILE* marker_fp = fopen(".marker","w");
-    assert(marker_fp);
-    fprintf(marker_fp, "%llx %llx", 
-            (unsigned long long int) &MARKER_START,
-            (unsigned long long int) &MARKER_END );
-    fclose(marker_fp);
+    int* valid = malloc(func_counter * sizeof(int));
+    assert(valid);
+    for (i=0; i < func_counter; i++)
+        valid[i] = -1;
 
     if (-1==selectedFunc) {
-        /* Invoke registered transpose functions */
+        /* Invoke registered transpose functions, each in its own marker
+           window, except generated kernels meant for another size */
         for (i=0; i < func_counter; i++) {
-            MARKER_START = 33;
-            (*func_list[i].func_ptr)(M, N, A, B);
-            MARKER_END = 34;
-            if (!validate(i,M,N,A,B))
-                return i+1;
+            if (!transFunctionFitsSize(i, M, N))
+                continue;
+            valid[i] = run_function(i);
+            if (!valid[i] && status == 0)
+                status = i < 255 ? i+1 : 255;
         }
     } else {
-        MARKER_START = 33;
-        (*func_list[selectedFunc].func_ptr)(M, N, A, B);
-        MARKER_END = 34;
-        if (!validate(selectedFunc,M,N,A,B))
-            return selectedFunc+1;
-
+        if (selectedFunc < 0 || selectedFunc >= func_counter) {
+            printf("./tracegen: no function %d\n", selectedFunc);
+            exit(1);
+        }
+        valid[selectedFunc] = run_function(selectedFunc);
+        if (!valid[selectedFunc])
+            status = selectedFunc < 255 ? selectedFunc+1 : 255;
     }
-    return 0;
+
+    /* Record marker addresses */
+    write_markers(valid);
+    free(valid);
+    return status;
 }
 
 
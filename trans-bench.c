@@ -0,0 +1,221 @@
+/*
+ * trans-bench.c - Times transposes on the host, in wall-clock time rather
+ *     than simulated misses: the SIMD kernels of trans-simd.c and the
+ *     parallel one of trans-par.c against transpose_submit and
+ *     correctTrans, at several sizes, and the in-place kernels of trans.c
+ *     against all of them.
+ *
+ * trans.c is compiled in at -O2 here, so its kernels are timed as an
+ * optimizing build would run them, not as the -O0 tracer runs them.
+ * Every kernel is checked against correctTrans before it is timed, and
+ * is then run repeatedly until the minimum time has passed. Reported are
+ * the mean time per element and the bandwidth, counting one read and one
+ * write of every element. transpose_parallel is timed at each thread
+ * count of -P, to show where it stops scaling.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "cachelab.h"
+#include "trans-simd.h"
+#include "trans-par.h"
+
+#define MAX_SIZES 32
+#define MAX_KERNELS 256
+#define ALIGNMENT 64
+
+extern void registerFunctions();
+extern trans_func_t* func_list;
+extern int func_counter;
+
+extern void transpose_submit(int M, int N, int A[N][M], int B[M][N]);
+extern char transpose_submit_desc[];
+
+extern void transpose_inplace_square(int M, int N, int A[N][M]);
+extern void transpose_inplace_cycles(int M, int N, int A[N][M]);
+extern char transpose_inplace_square_desc[], transpose_inplace_cycles_desc[];
+
+/* A serial kernel, an in-place one, or transpose_parallel when threads > 0 */
+typedef struct bench_kernel {
+    void (*func)(int M, int N, int A[N][M], int B[M][N]);
+    void (*inplace)(int M, int N, int A[N][M]);
+    int threads;
+    char name[64];
+} bench_kernel;
+
+static void add_kernel(bench_kernel *kernels, int *num_kernels, void (*func)(int M, int N, int A[N][M], int B[M][N]),
+                       void (*inplace)(int M, int N, int A[N][M]), int threads, const char *name)
+{
+    if (*num_kernels == MAX_KERNELS)
+        return;
+    kernels[*num_kernels].func = func;
+    kernels[*num_kernels].inplace = inplace;
+    kernels[*num_kernels].threads = threads;
+    snprintf(kernels[*num_kernels].name, sizeof(kernels[*num_kernels].name), "%s", name);
+    (*num_kernels)++;
+}
+
+/*
+ * run_kernel - Transpose A into B once. In-place kernels work on B alone,
+ *     which holds A^T after an odd number of runs and A after an even one.
+ */
+static void run_kernel(const bench_kernel *kern, int M, int N, int *A, int *B, long run)
+{
+    if (kern->inplace && run % 2 == 0)
+        kern->inplace(M, N, (void *) B);
+    else if (kern->inplace)
+        kern->inplace(N, M, (void *) B);
+    else if (kern->threads > 0)
+        transpose_parallel(M, N, (void *) A, (void *) B, kern->threads);
+    else
+        kern->func(M, N, (void *) A, (void *) B);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * bench_one - Check kern at M x N, then time it. Returns the mean seconds
+ *     per call, or -1 if it got the transpose wrong.
+ */
+static double bench_one(const bench_kernel *kern, int M, int N, int *A, int *B, int *expected, double min_seconds)
+{
+    long runs = 0;
+    double start, elapsed;
+
+    if (kern->inplace)
+        memcpy(B, A, sizeof(int) * M * N);
+    else
+        memset(B, 0, sizeof(int) * M * N);
+    run_kernel(kern, M, N, A, B, 0);
+    if (memcmp(B, expected, sizeof(int) * M * N) != 0)
+        return -1;
+
+    start = now();
+    do {
+        run_kernel(kern, M, N, A, B, runs + 1);
+        runs++;
+        elapsed = now() - start;
+    } while (elapsed < min_seconds);
+    return elapsed / runs;
+}
+
+static void usage(char *argv[])
+{
+    printf("Usage: %s [-ha] [-S <sizes>] [-P <threads>] [-r <ms>]\n", argv[0]);
+    printf("  -a            Also time every function trans.c registers\n");
+    printf("  -S <sizes>    Comma separated MxN sizes (default %s)\n", "32x32,64x64,61x67,256x256,1000x1000,2048x2048");
+    printf("  -P <threads>  Comma separated thread counts for transpose_parallel\n");
+    printf("                (default 1, 2, 4, ... up to the number of CPUs)\n");
+    printf("  -r <ms>       Minimum time spent on each kernel and size (default 100)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    char default_sizes[] = "32x32,64x64,61x67,256x256,1000x1000,2048x2048";
+    char *sizes = default_sizes, *thread_counts = NULL, *save;
+    int size_m[MAX_SIZES], size_n[MAX_SIZES], num_sizes = 0;
+    int all = 0, c;
+    double min_seconds = 0.1;
+    static bench_kernel kernels[MAX_KERNELS];
+    char name[64];
+    int num_kernels = 0;
+
+    while ((c = getopt(argc, argv, "haS:P:r:")) != -1) {
+        switch (c) {
+        case 'a': all = 1; break;
+        case 'S': sizes = optarg; break;
+        case 'P': thread_counts = optarg; break;
+        case 'r': min_seconds = atof(optarg) / 1000; break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+
+    for (char *tok = strtok_r(sizes, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+        if (num_sizes == MAX_SIZES || sscanf(tok, "%dx%d", &size_m[num_sizes], &size_n[num_sizes]) != 2 ||
+            size_m[num_sizes] < 1 || size_n[num_sizes] < 1) {
+            printf("Error: bad size \"%s\"\n", tok);
+            exit(1);
+        }
+        num_sizes++;
+    }
+
+    add_kernel(kernels, &num_kernels, correctTrans, NULL, 0, "correctTrans");
+    add_kernel(kernels, &num_kernels, transpose_submit, NULL, 0, transpose_submit_desc);
+    add_kernel(kernels, &num_kernels, transpose_sse_4x4, NULL, 0, "SSE2 4x4 micro-tiles");
+    add_kernel(kernels, &num_kernels, transpose_avx2_8x8, NULL, 0, "AVX2 8x8 micro-tiles");
+    add_kernel(kernels, &num_kernels, transpose_simd, NULL, 0, "SIMD, dispatched");
+    add_kernel(kernels, &num_kernels, NULL, transpose_inplace_square, 0, transpose_inplace_square_desc);
+    add_kernel(kernels, &num_kernels, NULL, transpose_inplace_cycles, 0, transpose_inplace_cycles_desc);
+    if (thread_counts != NULL) {
+        for (char *tok = strtok_r(thread_counts, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+            int threads = atoi(tok);
+            if (threads < 1 || threads > PAR_MAX_THREADS) {
+                printf("Error: thread counts must be between 1 and %d\n", PAR_MAX_THREADS);
+                exit(1);
+            }
+            snprintf(name, sizeof(name), "parallel, %d threads", threads);
+            add_kernel(kernels, &num_kernels, NULL, NULL, threads, name);
+        }
+    } else {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int threads = 1; threads <= cpus && threads <= PAR_MAX_THREADS; threads *= 2) {
+            snprintf(name, sizeof(name), "parallel, %d threads", threads);
+            add_kernel(kernels, &num_kernels, NULL, NULL, threads, name);
+        }
+    }
+    if (all) {
+        registerFunctions();
+        for (int i = 0; i < func_counter; i++) {
+            if (func_list[i].func_ptr != transpose_submit && func_list[i].inplace_ptr != transpose_inplace_square &&
+                func_list[i].inplace_ptr != transpose_inplace_cycles)
+                add_kernel(kernels, &num_kernels, func_list[i].func_ptr, func_list[i].inplace_ptr, 0,
+                           func_list[i].description);
+        }
+    }
+
+    printf("SIMD level: %s\n", transpose_simd_level());
+    printf("%-11s %-56s %10s %8s\n", "size", "kernel", "ns/elem", "GB/s");
+    for (int s = 0; s < num_sizes; s++) {
+        int M = size_m[s], N = size_n[s];
+        size_t bytes = sizeof(int) * M * N;
+        int *A, *B, *expected;
+        char size_text[32];
+
+        if (posix_memalign((void **) &A, ALIGNMENT, bytes) != 0 ||
+            posix_memalign((void **) &B, ALIGNMENT, bytes) != 0 ||
+            posix_memalign((void **) &expected, ALIGNMENT, bytes) != 0) {
+            printf("Error: can't allocate %dx%d matrices\n", M, N);
+            exit(1);
+        }
+        for (long i = 0; i < (long) M * N; i++)
+            A[i] = (int) i;
+        correctTrans(M, N, (void *) A, (void *) expected);
+
+        snprintf(size_text, sizeof(size_text), "%dx%d", M, N);
+        for (int k = 0; k < num_kernels; k++) {
+            double seconds = bench_one(&kernels[k], M, N, A, B, expected, min_seconds);
+            if (seconds < 0)
+                printf("%-11s %-56.56s %10s %8s\n", size_text, kernels[k].name, "wrong", "-");
+            else
+                printf("%-11s %-56.56s %10.3f %8.2f\n", size_text, kernels[k].name,
+                       seconds * 1e9 / ((double) M * N), 2.0 * bytes / seconds / 1e9);
+        }
+        free(A);
+        free(B);
+        free(expected);
+    }
+    return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * trans-par.c - Work-stealing tiled transpose (see trans-par.h)
+ */
+#define _GNU_SOURCE
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "trans-par.h"
+#include "trans-simd.h"
+
+/* Side of a tile, in ints: 16KB of A and 16KB of buffer */
+#ifndef PAR_TILE
+#define PAR_TILE 64
+#endif
+
+struct par_job;
+
+/* One thread's tiles not yet taken are [next, end), guarded by lock. They
+   are stored atomically, since thieves read them without the lock. */
+typedef struct par_worker {
+    pthread_mutex_t lock;
+    long next, end;
+    int id;
+    pthread_t thread;
+    struct par_job *job;
+} par_worker;
+
+typedef struct par_job {
+    int M, N;
+    const int *A;
+    int *B;
+    int tile_cols;      /* tiles across a row of A */
+    int threads;
+    par_worker workers[PAR_MAX_THREADS];
+} par_job;
+
+/*
+ * steal - Move the upper half of the largest range another worker has
+ *     left to self. Returns 0 if every range is empty, so the job is done
+ *     (tiles in flight between two workers always belong to the thief).
+ */
+static int steal(par_job *job, par_worker *self)
+{
+    for (;;) {
+        par_worker *victim = NULL;
+        long most = 0;
+
+        for (int k = 1; k < job->threads; k++) {
+            par_worker *w = &job->workers[(self->id + k) % job->threads];
+            // only a hint; checked again under the lock
+            long left = __atomic_load_n(&w->end, __ATOMIC_RELAXED) - __atomic_load_n(&w->next, __ATOMIC_RELAXED);
+            if (left > most) {
+                most = left;
+                victim = w;
+            }
+        }
+        if (victim == NULL)
+            return 0;
+
+        pthread_mutex_lock(&victim->lock);
+        long left = victim->end - victim->next;
+        long lo = victim->end - (left + 1) / 2, hi = victim->end;
+        if (left > 0)
+            __atomic_store_n(&victim->end, lo, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&victim->lock);
+
+        if (left > 0) {
+            pthread_mutex_lock(&self->lock);
+            __atomic_store_n(&self->next, lo, __ATOMIC_RELAXED);
+            __atomic_store_n(&self->end, hi, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&self->lock);
+            return 1;
+        }
+    }
+}
+
+/* take - The next tile for self, or -1 when there are none left anywhere */
+static long take(par_job *job, par_worker *self)
+{
+    for (;;) {
+        long tile = -1;
+
+        pthread_mutex_lock(&self->lock);
+        if (self->next < self->end) {
+            tile = self->next;
+            __atomic_store_n(&self->next, tile + 1, __ATOMIC_RELAXED);
+        }
+        pthread_mutex_unlock(&self->lock);
+        if (tile >= 0)
+            return tile;
+        if (!steal(job, self))
+            return -1;
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    par_worker *self = arg;
+    par_job *job = self->job;
+    int M = job->M, N = job->N;
+    int buf[PAR_TILE * PAR_TILE] __attribute__((aligned(64)));
+    long tile;
+
+    while ((tile = take(job, self)) >= 0) {
+        int i0 = (int) (tile / job->tile_cols) * PAR_TILE, j0 = (int) (tile % job->tile_cols) * PAR_TILE;
+        int rows = N - i0 < PAR_TILE ? N - i0 : PAR_TILE;
+        int cols = M - j0 < PAR_TILE ? M - j0 : PAR_TILE;
+
+        transpose_simd_block(rows, cols, job->A + (long) i0 * M + j0, M, buf, PAR_TILE);
+        for (int j = 0; j < cols; j++)
+            memcpy(job->B + (long) (j0 + j) * N + i0, buf + j * PAR_TILE, sizeof(int) * rows);
+    }
+    return NULL;
+}
+
+void transpose_parallel(int M, int N, int A[N][M], int B[M][N], int threads)
+{
+    par_job job;
+    long tiles;
+
+    if (threads <= 0)
+        threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > PAR_MAX_THREADS)
+        threads = PAR_MAX_THREADS;
+
+    job.M = M;
+    job.N = N;
+    job.A = &A[0][0];
+    job.B = &B[0][0];
+    job.tile_cols = (M + PAR_TILE - 1) / PAR_TILE;
+    tiles = (long) job.tile_cols * ((N + PAR_TILE - 1) / PAR_TILE);
+    if (threads > tiles)
+        threads = (int) tiles;
+    if (threads < 1)
+        threads = 1;
+    job.threads = threads;
+
+    for (int t = 0; t < threads; t++) {
+        par_worker *w = &job.workers[t];
+        pthread_mutex_init(&w->lock, NULL);
+        w->next = tiles * t / threads;
+        w->end = tiles * (t + 1) / threads;
+        w->id = t;
+        w->job = &job;
+    }
+    for (int t = 1; t < threads; t++)
+        pthread_create(&job.workers[t].thread, NULL, worker_main, &job.workers[t]);
+    worker_main(&job.workers[0]);
+    for (int t = 1; t < threads; t++)
+        pthread_join(job.workers[t].thread, NULL);
+    for (int t = 0; t < threads; t++)
+        pthread_mutex_destroy(&job.workers[t].lock);
+}
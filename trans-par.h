@@ -0,0 +1,22 @@
+/*
+ * trans-par.h - Multi-threaded transpose for matrices far bigger than the
+ *     lab's, on the host.
+ *
+ * The matrix is cut into PAR_TILE x PAR_TILE tiles, and every thread
+ * starts with an equal, contiguous range of them. A thread that runs out
+ * steals the upper half of the largest range left, so uneven progress
+ * (other load, frequency changes, NUMA) is evened out without a shared
+ * queue on the hot path. Each tile is transposed with the SIMD kernels
+ * into a thread-local buffer and then written to B one whole row at a time.
+ */
+#ifndef TRANS_PAR_H
+#define TRANS_PAR_H
+
+/* Most threads transpose_parallel starts */
+#define PAR_MAX_THREADS 64
+
+/* B = A^T with the given number of threads, counting the caller; 0
+   means one per online CPU */
+void transpose_parallel(int M, int N, int A[N][M], int B[M][N], int threads);
+
+#endif /* TRANS_PAR_H */
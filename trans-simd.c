@@ -0,0 +1,174 @@
+/*
+ * trans-simd.c - SSE2 and AVX2 transpose kernels (see trans-simd.h)
+ *
+ * Both kernels walk the matrix in SIMD_TILE x SIMD_TILE blocks (16KB of
+ * A and 16KB of B by default) so that the lines a block touches stay in
+ * L1 or at worst L2 until it is done, and transpose each block as a grid
+ * of micro-tiles held entirely in registers. Inside a block, micro-tiles
+ * are visited down A's columns, so consecutive micro-tiles extend the
+ * same rows of B.
+ */
+#include <immintrin.h>
+#include <pthread.h>
+#include "trans-simd.h"
+
+/* Side of the cache block, in ints; a multiple of 8 */
+#ifndef SIMD_TILE
+#define SIMD_TILE 64
+#endif
+
+/* Transposes the k x k tile at a (row stride lda) into b (row stride ldb) */
+typedef void (*micro_kernel)(const int *a, int lda, int *b, int ldb);
+
+/*
+ * micro_sse_4x4 - Two rounds of unpacks: 32-bit interleaves pair up rows
+ *     0/1 and 2/3, then 64-bit interleaves join the pairs into columns.
+ */
+static inline void micro_sse_4x4(const int *a, int lda, int *b, int ldb)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i *) (a + 0 * lda));
+    __m128i r1 = _mm_loadu_si128((const __m128i *) (a + 1 * lda));
+    __m128i r2 = _mm_loadu_si128((const __m128i *) (a + 2 * lda));
+    __m128i r3 = _mm_loadu_si128((const __m128i *) (a + 3 * lda));
+
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);    // a00 a10 a01 a11
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);    // a20 a30 a21 a31
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);    // a02 a12 a03 a13
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);    // a22 a32 a23 a33
+
+    _mm_storeu_si128((__m128i *) (b + 0 * ldb), _mm_unpacklo_epi64(t0, t1));
+    _mm_storeu_si128((__m128i *) (b + 1 * ldb), _mm_unpackhi_epi64(t0, t1));
+    _mm_storeu_si128((__m128i *) (b + 2 * ldb), _mm_unpacklo_epi64(t2, t3));
+    _mm_storeu_si128((__m128i *) (b + 3 * ldb), _mm_unpackhi_epi64(t2, t3));
+}
+
+/*
+ * micro_avx2_8x8 - The 4x4 network runs in both 128-bit lanes at once,
+ *     leaving columns 0-3 of each group of four rows in the low lanes
+ *     and columns 4-7 in the high lanes; a lane permute then joins rows
+ *     0-3 and 4-7 of each column.
+ */
+__attribute__((target("avx2")))
+static inline void micro_avx2_8x8(const int *a, int lda, int *b, int ldb)
+{
+    __m256i r0 = _mm256_loadu_si256((const __m256i *) (a + 0 * lda));
+    __m256i r1 = _mm256_loadu_si256((const __m256i *) (a + 1 * lda));
+    __m256i r2 = _mm256_loadu_si256((const __m256i *) (a + 2 * lda));
+    __m256i r3 = _mm256_loadu_si256((const __m256i *) (a + 3 * lda));
+    __m256i r4 = _mm256_loadu_si256((const __m256i *) (a + 4 * lda));
+    __m256i r5 = _mm256_loadu_si256((const __m256i *) (a + 5 * lda));
+    __m256i r6 = _mm256_loadu_si256((const __m256i *) (a + 6 * lda));
+    __m256i r7 = _mm256_loadu_si256((const __m256i *) (a + 7 * lda));
+
+    __m256i t0 = _mm256_unpacklo_epi32(r0, r1);     // a00 a10 a01 a11 | a04 a14 a05 a15
+    __m256i t1 = _mm256_unpackhi_epi32(r0, r1);     // a02 a12 a03 a13 | a06 a16 a07 a17
+    __m256i t2 = _mm256_unpacklo_epi32(r2, r3);
+    __m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+    __m256i t4 = _mm256_unpacklo_epi32(r4, r5);
+    __m256i t5 = _mm256_unpackhi_epi32(r4, r5);
+    __m256i t6 = _mm256_unpacklo_epi32(r6, r7);
+    __m256i t7 = _mm256_unpackhi_epi32(r6, r7);
+
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);     // a00 a10 a20 a30 | a04 a14 a24 a34
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);     // a40 a50 a60 a70 | a44 a54 a64 a74
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    _mm256_storeu_si256((__m256i *) (b + 0 * ldb), _mm256_permute2x128_si256(u0, u4, 0x20));
+    _mm256_storeu_si256((__m256i *) (b + 1 * ldb), _mm256_permute2x128_si256(u1, u5, 0x20));
+    _mm256_storeu_si256((__m256i *) (b + 2 * ldb), _mm256_permute2x128_si256(u2, u6, 0x20));
+    _mm256_storeu_si256((__m256i *) (b + 3 * ldb), _mm256_permute2x128_si256(u3, u7, 0x20));
+    _mm256_storeu_si256((__m256i *) (b + 4 * ldb), _mm256_permute2x128_si256(u0, u4, 0x31));
+    _mm256_storeu_si256((__m256i *) (b + 5 * ldb), _mm256_permute2x128_si256(u1, u5, 0x31));
+    _mm256_storeu_si256((__m256i *) (b + 6 * ldb), _mm256_permute2x128_si256(u2, u6, 0x31));
+    _mm256_storeu_si256((__m256i *) (b + 7 * ldb), _mm256_permute2x128_si256(u3, u7, 0x31));
+}
+
+/*
+ * transpose_tiled - Transpose the rows x cols block A (row stride lda)
+ *     into B (row stride ldb) with k x k micro-tiles of kern over the
+ *     largest part whose sides are multiples of k, then copy the leftover
+ *     rows and columns directly. Always inlined, so that each caller gets
+ *     its own copy with kern called directly.
+ */
+static inline __attribute__((always_inline))
+void transpose_tiled(int rows, int cols, const int *A, int lda, int *B, int ldb, int k, micro_kernel kern)
+{
+    int full_rows = rows - rows % k, full_cols = cols - cols % k;
+
+    for (int i0 = 0; i0 < full_rows; i0 += SIMD_TILE) {
+        int i_end = i0 + SIMD_TILE < full_rows ? i0 + SIMD_TILE : full_rows;
+        for (int j0 = 0; j0 < full_cols; j0 += SIMD_TILE) {
+            int j_end = j0 + SIMD_TILE < full_cols ? j0 + SIMD_TILE : full_cols;
+            for (int j = j0; j < j_end; j += k) {
+                for (int i = i0; i < i_end; i += k) {
+                    kern(A + (long) i * lda + j, lda, B + (long) j * ldb + i, ldb);
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < full_rows; i++) {
+        for (int j = full_cols; j < cols; j++) {
+            B[(long) j * ldb + i] = A[(long) i * lda + j];
+        }
+    }
+    for (int i = full_rows; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            B[(long) j * ldb + i] = A[(long) i * lda + j];
+        }
+    }
+}
+
+static void block_sse_4x4(int rows, int cols, const int *A, int lda, int *B, int ldb)
+{
+    transpose_tiled(rows, cols, A, lda, B, ldb, 4, micro_sse_4x4);
+}
+
+__attribute__((target("avx2")))
+static void block_avx2_8x8(int rows, int cols, const int *A, int lda, int *B, int ldb)
+{
+    transpose_tiled(rows, cols, A, lda, B, ldb, 8, micro_avx2_8x8);
+}
+
+void transpose_sse_4x4(int M, int N, int A[N][M], int B[M][N])
+{
+    block_sse_4x4(N, M, &A[0][0], M, &B[0][0], N);
+}
+
+void transpose_avx2_8x8(int M, int N, int A[N][M], int B[M][N])
+{
+    if (__builtin_cpu_supports("avx2"))
+        block_avx2_8x8(N, M, &A[0][0], M, &B[0][0], N);
+    else
+        block_sse_4x4(N, M, &A[0][0], M, &B[0][0], N);
+}
+
+/* The block kernel for this CPU, picked once by the first call */
+static void (*simd_block)(int rows, int cols, const int *A, int lda, int *B, int ldb);
+static pthread_once_t simd_block_once = PTHREAD_ONCE_INIT;
+
+static void pick_simd_block(void)
+{
+    simd_block = __builtin_cpu_supports("avx2") ? block_avx2_8x8 : block_sse_4x4;
+}
+
+const char *transpose_simd_level(void)
+{
+    return __builtin_cpu_supports("avx2") ? "avx2" : "sse2";
+}
+
+void transpose_simd_block(int rows, int cols, const int *A, int lda, int *B, int ldb)
+{
+    pthread_once(&simd_block_once, pick_simd_block);
+    simd_block(rows, cols, A, lda, B, ldb);
+}
+
+void transpose_simd(int M, int N, int A[N][M], int B[M][N])
+{
+    transpose_simd_block(N, M, &A[0][0], M, &B[0][0], N);
+}
@@ -0,0 +1,31 @@
+/*
+ * trans-simd.h - Native transposes built from SIMD micro-kernels: an SSE2
+ *     4x4 and an AVX2 8x8 unpack/shuffle/permute network. They are for
+ *     speed on the host, not for the simulator, so they live outside
+ *     trans.c and are not registered with test-trans.
+ *
+ * All of them take the usual transpose arguments and handle any M and N;
+ * the rows and columns that don't fill a whole micro-tile are copied one
+ * element at a time.
+ */
+#ifndef TRANS_SIMD_H
+#define TRANS_SIMD_H
+
+/* 4x4 micro-tiles in SSE2 registers (every x86-64 CPU has SSE2) */
+void transpose_sse_4x4(int M, int N, int A[N][M], int B[M][N]);
+
+/* 8x8 micro-tiles in AVX2 registers; falls back to transpose_sse_4x4
+   on a CPU without AVX2 */
+void transpose_avx2_8x8(int M, int N, int A[N][M], int B[M][N]);
+
+/* The widest of the above that this CPU supports, chosen on first call */
+void transpose_simd(int M, int N, int A[N][M], int B[M][N]);
+
+/* transpose_simd on part of a matrix: the rows x cols block at A, whose
+   rows are lda ints apart, to the cols x rows block at B (ldb apart) */
+void transpose_simd_block(int rows, int cols, const int *A, int lda, int *B, int ldb);
+
+/* "avx2" or "sse2": what transpose_simd uses on this CPU */
+const char *transpose_simd_level(void);
+
+#endif /* TRANS_SIMD_H */
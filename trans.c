@@ -14,11 +14,31 @@
  * A transpose function is evaluated by counting the number of misses
  * on a 1KB direct mapped cache with a block size of 32 bytes.
  */ 
+#define _GNU_SOURCE
 #include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
 #include "cachelab.h"
 
 int is_transpose(int M, int N, int A[N][M], int B[M][N]);
 
+/*
+ * CHECK_TRANS - With make CHECK=1, kernels that end with this check their
+ *     own result with is_transpose and abort on a wrong one. The check
+ *     reads all of A and B, so leave it off when counting misses.
+ */
+#ifdef CHECK_TRANSPOSE
+#define CHECK_TRANS(name, M, N, A, B) \
+    do { \
+        if (!is_transpose(M, N, A, B)) { \
+            fprintf(stderr, "%s: wrong result for %dx%d\n", name, M, N); \
+            abort(); \
+        } \
+    } while (0)
+#else
+#define CHECK_TRANS(name, M, N, A, B) do { } while (0)
+#endif
+
 /* 
  * transpose_submit - This is the solution transpose function that you
  *     will be graded on for Part B of the assignment. Do not change
@@ -132,6 +152,419 @@ void trans(int M, int N, int A[N][M], int B[M][N])
     }
 }
 
+/*
+ * transpose_32x32_buffered - 8x8 blocks like transpose_submit's 32x32 path,
+ *     but each 8-int row of a block is read into locals before any of it is
+ *     written to B. A and B map to the same sets on the diagonal blocks, so
+ *     copying element by element there makes every store to B evict the
+ *     line of A still being read. With the row in locals, a diagonal block
+ *     costs just one extra miss per row: the store to B's row i evicts A's
+ *     row i only after it has been read. This reaches the ~287-miss bound
+ *     on the 1KB direct-mapped cache. Other sizes go to correctTrans.
+ */
+char transpose_32x32_buffered_desc[] = "32x32 8x8 blocks with register-buffered rows";
+void transpose_32x32_buffered(int M, int N, int A[N][M], int B[M][N])
+{
+    if (M != 32 || N != 32) {
+        correctTrans(M, N, A, B);
+        return;
+    }
+
+    for (int block_row = 0; block_row < 32; block_row += 8) {
+        for (int block_col = 0; block_col < 32; block_col += 8) {
+            //On a diagonal block, B[row][row] shares a set with A[row], so its
+            // store has to come after the last read of A[row]
+            for (int row = block_row; row < block_row + 8; row++) {
+                //Read the whole row of the block before writing any of it
+                int a0 = A[row][block_col];
+                int a1 = A[row][block_col + 1];
+                int a2 = A[row][block_col + 2];
+                int a3 = A[row][block_col + 3];
+                int a4 = A[row][block_col + 4];
+                int a5 = A[row][block_col + 5];
+                int a6 = A[row][block_col + 6];
+                int a7 = A[row][block_col + 7];
+                B[block_col][row] = a0;
+                B[block_col + 1][row] = a1;
+                B[block_col + 2][row] = a2;
+                B[block_col + 3][row] = a3;
+                B[block_col + 4][row] = a4;
+                B[block_col + 5][row] = a5;
+                B[block_col + 6][row] = a6;
+                B[block_col + 7][row] = a7;
+            }
+        }
+    }
+
+    CHECK_TRANS("transpose_32x32_buffered", M, N, A, B);
+}
+
+/*
+ * transpose_64x64_shuffle - 8x8 blocks for 64x64. Rows of A (and of B) are
+ *     256 bytes apart, so on the 1KB cache only four rows of a block fit
+ *     before the sets repeat, which is why transpose_submit falls back to
+ *     4x4 blocks and uses half of every line. Here every 32-byte line of A
+ *     that is loaded is used in full, with the top half of B's block as
+ *     temporary storage:
+ *       1. A's top four rows go to B's top four rows: the left quadrant
+ *          transposed into place, the right quadrant transposed into B's
+ *          top-right, where it doesn't belong yet.
+ *       2. For each of those B rows, the parked top-right quadrant row is
+ *          read back, replaced by A's bottom-left quadrant column, and
+ *          written to its real place in B's bottom-left.
+ *       3. A's bottom-right quadrant is transposed into B's bottom-right.
+ *     Other sizes go to correctTrans.
+ */
+char transpose_64x64_shuffle_desc[] = "64x64 8x8 blocks with 4x4 quadrants shuffled through B";
+void transpose_64x64_shuffle(int M, int N, int A[N][M], int B[M][N])
+{
+    if (M != 64 || N != 64) {
+        correctTrans(M, N, A, B);
+        return;
+    }
+
+    for (int block_row = 0; block_row < 64; block_row += 8) {
+        for (int block_col = 0; block_col < 64; block_col += 8) {
+            int a0, a1, a2, a3, a4, a5, a6, a7;
+
+            //1. Top half of A: left quadrant into place, right quadrant parked in B's top-right
+            for (int row = block_row; row < block_row + 4; row++) {
+                a0 = A[row][block_col];
+                a1 = A[row][block_col + 1];
+                a2 = A[row][block_col + 2];
+                a3 = A[row][block_col + 3];
+                a4 = A[row][block_col + 4];
+                a5 = A[row][block_col + 5];
+                a6 = A[row][block_col + 6];
+                a7 = A[row][block_col + 7];
+                B[block_col][row] = a0;
+                B[block_col + 1][row] = a1;
+                B[block_col + 2][row] = a2;
+                B[block_col + 3][row] = a3;
+                B[block_col][row + 4] = a4;
+                B[block_col + 1][row + 4] = a5;
+                B[block_col + 2][row + 4] = a6;
+                B[block_col + 3][row + 4] = a7;
+            }
+
+            //2. Swap the parked quadrant out of B's top-right for A's bottom-left
+            for (int col = block_col; col < block_col + 4; col++) {
+                a0 = B[col][block_row + 4];
+                a1 = B[col][block_row + 5];
+                a2 = B[col][block_row + 6];
+                a3 = B[col][block_row + 7];
+                a4 = A[block_row + 4][col];
+                a5 = A[block_row + 5][col];
+                a6 = A[block_row + 6][col];
+                a7 = A[block_row + 7][col];
+                B[col][block_row + 4] = a4;
+                B[col][block_row + 5] = a5;
+                B[col][block_row + 6] = a6;
+                B[col][block_row + 7] = a7;
+                B[col + 4][block_row] = a0;
+                B[col + 4][block_row + 1] = a1;
+                B[col + 4][block_row + 2] = a2;
+                B[col + 4][block_row + 3] = a3;
+            }
+
+            //3. Bottom-right quadrant straight into place
+            for (int row = block_row + 4; row < block_row + 8; row++) {
+                a0 = A[row][block_col + 4];
+                a1 = A[row][block_col + 5];
+                a2 = A[row][block_col + 6];
+                a3 = A[row][block_col + 7];
+                B[block_col + 4][row] = a0;
+                B[block_col + 5][row] = a1;
+                B[block_col + 6][row] = a2;
+                B[block_col + 7][row] = a3;
+            }
+        }
+    }
+
+    CHECK_TRANS("transpose_64x64_shuffle", M, N, A, B);
+}
+
+/*
+ * rows_apart - How many consecutive rows (at most 8) of a matrix with the
+ *     given row length map to different sets of the 1KB direct-mapped
+ *     cache, wherever the first one starts. Two rows collide when they are
+ *     a multiple of 256 ints apart, give or take a line.
+ */
+static int rows_apart(int row_len)
+{
+    for (int rows = 2; rows <= 8; rows++) {
+        int distance = ((rows - 1) * row_len) % 256;
+        if (distance < 8 || distance > 248)
+            return rows - 1;
+    }
+    return 8;
+}
+
+/*
+ * copy_row_segment - B[col..col+width)[row] = A[row][col..col+width), for
+ *     width up to 8, reading the whole segment of A before writing B
+ */
+static void copy_row_segment(int M, int N, int A[N][M], int B[M][N], int row, int col, int width)
+{
+    int a0 = 0, a1 = 0, a2 = 0, a3 = 0, a4 = 0, a5 = 0, a6 = 0, a7 = 0;
+
+    switch (width) {
+    case 8: a7 = A[row][col + 7]; /* fall through */
+    case 7: a6 = A[row][col + 6]; /* fall through */
+    case 6: a5 = A[row][col + 5]; /* fall through */
+    case 5: a4 = A[row][col + 4]; /* fall through */
+    case 4: a3 = A[row][col + 3]; /* fall through */
+    case 3: a2 = A[row][col + 2]; /* fall through */
+    case 2: a1 = A[row][col + 1]; /* fall through */
+    case 1: a0 = A[row][col];
+    }
+    switch (width) {
+    case 8: B[col + 7][row] = a7; /* fall through */
+    case 7: B[col + 6][row] = a6; /* fall through */
+    case 6: B[col + 5][row] = a5; /* fall through */
+    case 5: B[col + 4][row] = a4; /* fall through */
+    case 4: B[col + 3][row] = a3; /* fall through */
+    case 3: B[col + 2][row] = a2; /* fall through */
+    case 2: B[col + 1][row] = a1; /* fall through */
+    case 1: B[col][row] = a0;
+    }
+}
+
+/*
+ * copy_col_segment - B[col][row..row+height) = A[row..row+height)[col], for
+ *     height up to 8, reading the whole segment of A before writing B
+ */
+static void copy_col_segment(int M, int N, int A[N][M], int B[M][N], int row, int col, int height)
+{
+    int a0 = 0, a1 = 0, a2 = 0, a3 = 0, a4 = 0, a5 = 0, a6 = 0, a7 = 0;
+
+    switch (height) {
+    case 8: a7 = A[row + 7][col]; /* fall through */
+    case 7: a6 = A[row + 6][col]; /* fall through */
+    case 6: a5 = A[row + 5][col]; /* fall through */
+    case 5: a4 = A[row + 4][col]; /* fall through */
+    case 4: a3 = A[row + 3][col]; /* fall through */
+    case 3: a2 = A[row + 2][col]; /* fall through */
+    case 2: a1 = A[row + 1][col]; /* fall through */
+    case 1: a0 = A[row][col];
+    }
+    switch (height) {
+    case 8: B[col][row + 7] = a7; /* fall through */
+    case 7: B[col][row + 6] = a6; /* fall through */
+    case 6: B[col][row + 5] = a5; /* fall through */
+    case 5: B[col][row + 4] = a4; /* fall through */
+    case 4: B[col][row + 3] = a3; /* fall through */
+    case 3: B[col][row + 2] = a2; /* fall through */
+    case 2: B[col][row + 1] = a1; /* fall through */
+    case 1: B[col][row] = a0;
+    }
+}
+
+/*
+ * transpose_adaptive - Tile shapes picked from how the actual M and N map
+ *     onto the 1KB direct-mapped cache, for any rectangular matrix.
+ *
+ *     The interior is cut into strips that run the full length of the
+ *     matrix: either a few columns of A wide (a few rows of B), walked
+ *     down A's rows, or a few rows of A tall, walked across its columns.
+ *     Each step copies one short segment through locals, and the lines of
+ *     B (or A) that the strip spans are reused by the next seven steps as
+ *     long as they stay cached, so a strip is as wide as the rows it spans
+ *     can be while still landing in different sets. The direction with the
+ *     wider conflict-free strip wins; on a tie, strips run along the longer
+ *     side, so fewer of them restart.
+ *
+ *     What is left over, on the right edge for column strips or the bottom
+ *     edge for row strips, is narrower than a strip and gets a strip of its
+ *     own exact width, which reads each line of A it touches only once.
+ */
+char transpose_adaptive_desc[] = "Shape-adaptive strips with fitted edges";
+void transpose_adaptive(int M, int N, int A[N][M], int B[M][N])
+{
+    int down = rows_apart(N), across = rows_apart(M);
+
+    if (down > across || (down == across && N >= M)) {
+        //Column strips: `down` rows of B stay cached while walking down A
+        int interior = M - M % down;
+        for (int col = 0; col < interior; col += down) {
+            for (int row = 0; row < N; row++) {
+                copy_row_segment(M, N, A, B, row, col, down);
+            }
+        }
+
+        //Right edge: the last M % down columns, as one narrower strip
+        if (interior < M) {
+            for (int row = 0; row < N; row++) {
+                copy_row_segment(M, N, A, B, row, interior, M - interior);
+            }
+        }
+    } else {
+        //Row strips: `across` rows of A stay cached while walking across them
+        int interior = N - N % across;
+        for (int row = 0; row < interior; row += across) {
+            for (int col = 0; col < M; col++) {
+                copy_col_segment(M, N, A, B, row, col, across);
+            }
+        }
+
+        //Bottom edge: the last N % across rows, as one narrower strip
+        if (interior < N) {
+            for (int col = 0; col < M; col++) {
+                copy_col_segment(M, N, A, B, interior, col, N - interior);
+            }
+        }
+    }
+
+    CHECK_TRANS("transpose_adaptive", M, N, A, B);
+}
+
+/*
+ * REC_THRESHOLD - Largest block, in elements, that transpose_recursive
+ *     copies directly instead of splitting further. Override with
+ *     -DREC_THRESHOLD=<n>.
+ */
+#ifndef REC_THRESHOLD
+#define REC_THRESHOLD 16
+#endif
+#define TRANS_STR_(x) #x
+#define TRANS_STR(x) TRANS_STR_(x)
+
+/*
+ * transpose_block_rec - Transpose the rows x cols block of A whose top left
+ *     corner is (row, col), halving its longer side until the block has at
+ *     most threshold elements
+ */
+static void transpose_block_rec(int M, int N, int A[N][M], int B[M][N],
+                                int row, int col, int rows, int cols, int threshold)
+{
+    if (rows * cols <= threshold || (rows == 1 && cols == 1)) {
+        for (int i = row; i < row + rows; i++) {
+            for (int j = col; j < col + cols; j++) {
+                B[j][i] = A[i][j];
+            }
+        }
+    } else if (rows >= cols) {
+        transpose_block_rec(M, N, A, B, row, col, rows / 2, cols, threshold);
+        transpose_block_rec(M, N, A, B, row + rows / 2, col, rows - rows / 2, cols, threshold);
+    } else {
+        transpose_block_rec(M, N, A, B, row, col, rows, cols / 2, threshold);
+        transpose_block_rec(M, N, A, B, row, col + cols / 2, rows, cols - cols / 2, threshold);
+    }
+}
+
+/*
+ * transpose_recursive - Cache-oblivious transpose: split the matrix in two
+ *     along its longer side, recursively, until the pieces are small. At
+ *     some depth the pieces of A and B fit whatever cache there is, so
+ *     this does reasonably on every geometry without knowing any of them,
+ *     unlike the size-specific branches of transpose_submit.
+ */
+char transpose_recursive_desc[] = "Cache-oblivious recursive transpose";
+void transpose_recursive(int M, int N, int A[N][M], int B[M][N])
+{
+    transpose_block_rec(M, N, A, B, 0, 0, N, M, REC_THRESHOLD);
+    CHECK_TRANS("transpose_recursive", M, N, A, B);
+}
+
+/* The same with the base case at 64 and 256 elements, to compare thresholds */
+char transpose_recursive_64_desc[] = "Cache-oblivious recursive transpose, 64-element base";
+void transpose_recursive_64(int M, int N, int A[N][M], int B[M][N])
+{
+    transpose_block_rec(M, N, A, B, 0, 0, N, M, 64);
+}
+
+char transpose_recursive_256_desc[] = "Cache-oblivious recursive transpose, 256-element base";
+void transpose_recursive_256(int M, int N, int A[N][M], int B[M][N])
+{
+    transpose_block_rec(M, N, A, B, 0, 0, N, M, 256);
+}
+
+/*
+ * transpose_inplace_cycles - In-place transpose of any shape by following
+ *     cycles. The element at offset p of A (row-major, N x M) belongs at
+ *     offset p*N mod (MN-1) of A^T, so each cycle of that permutation is
+ *     rotated by one element, carrying a single value along. A bit per
+ *     element records which offsets are already in place, so every cycle
+ *     is rotated once.
+ *
+ *     The bit-vector is mapped below 2GB rather than taken from malloc:
+ *     whether malloc uses the heap (counted) or a mapping of its own (not
+ *     counted) depends on the size, and its zeroing is traced by valgrind
+ *     but not by tracegen-cap. Fresh pages arrive zeroed without a traced
+ *     access, and the tracers count every access to them at any size.
+ */
+char transpose_inplace_cycles_desc[] = "In-place: follow permutation cycles with a bit-vector";
+void transpose_inplace_cycles(int M, int N, int A[N][M])
+{
+    int* a = &A[0][0];
+    long long size = (long long) M * N;
+    size_t bytes = (size + 7) / 8;
+    unsigned char* done;
+
+    if (size < 3)
+        return;
+    done = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (done == MAP_FAILED)
+        done = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (done == MAP_FAILED)
+        abort();
+
+    // Offsets 0 and MN-1 never move
+    for (long long start = 1; start < size - 1; start++) {
+        if (done[start / 8] & (1 << (start % 8)))
+            continue;
+        long long p = start;
+        int carried = a[start];
+        do {
+            long long q = p * N % (size - 1);
+            int displaced = a[q];
+            a[q] = carried;
+            done[q / 8] |= 1 << (q % 8);
+            carried = displaced;
+            p = q;
+        } while (p != start);
+    }
+    munmap(done, bytes);
+}
+
+/*
+ * transpose_inplace_square - In-place transpose of a square matrix by
+ *     swapping 8x8 tiles across the diagonal: each tile above it trades
+ *     elements with its mirror tile below, and each diagonal tile swaps
+ *     its own two triangles. Other shapes go to transpose_inplace_cycles.
+ */
+char transpose_inplace_square_desc[] = "In-place: swap 8x8 tile pairs across the diagonal";
+void transpose_inplace_square(int M, int N, int A[N][M])
+{
+    if (M != N) {
+        transpose_inplace_cycles(M, N, A);
+        return;
+    }
+
+    for (int bi = 0; bi < N; bi += 8) {
+        int bi_end = bi + 8 < N ? bi + 8 : N;
+        // The diagonal tile: swap the triangle above its diagonal with the one below
+        for (int i = bi; i < bi_end; i++) {
+            for (int j = i + 1; j < bi_end; j++) {
+                int tmp = A[i][j];
+                A[i][j] = A[j][i];
+                A[j][i] = tmp;
+            }
+        }
+        // Each tile to its right trades with the mirror tile below the diagonal
+        for (int bj = bi + 8; bj < N; bj += 8) {
+            int bj_end = bj + 8 < N ? bj + 8 : N;
+            for (int i = bi; i < bi_end; i++) {
+                for (int j = bj; j < bj_end; j++) {
+                    int tmp = A[i][j];
+                    A[i][j] = A[j][i];
+                    A[j][i] = tmp;
+                }
+            }
+        }
+    }
+}
+
 /*
  * registerFunctions - This function registers your transpose
  *     functions with the driver.  At runtime, the driver will
@@ -146,6 +579,19 @@ void registerFunctions()
 
     /* Register any additional transpose functions */
     registerTransFunction(trans, trans_desc); 
+    registerTransFunctionInfo(transpose_32x32_buffered, transpose_32x32_buffered_desc,
+                              "bsize=8,buffer=row", "blocked,32x32", 0);
+    registerTransFunctionInfo(transpose_64x64_shuffle, transpose_64x64_shuffle_desc,
+                              "bsize=8,quadrant=4", "blocked,64x64", 0);
+    registerTransFunctionInfo(transpose_adaptive, transpose_adaptive_desc, NULL, "blocked", 0);
+    registerTransFunctionInfo(transpose_recursive, transpose_recursive_desc, "threshold=" TRANS_STR(REC_THRESHOLD),
+                              "recursive", 0);
+    registerTransFunctionInfo(transpose_recursive_64, transpose_recursive_64_desc, "threshold=64", "recursive", 0);
+    registerTransFunctionInfo(transpose_recursive_256, transpose_recursive_256_desc, "threshold=256", "recursive", 0);
+
+    /* In-place functions, given only A */
+    registerInPlaceFunctionInfo(transpose_inplace_square, transpose_inplace_square_desc, "bsize=8", "blocked");
+    registerInPlaceFunctionInfo(transpose_inplace_cycles, transpose_inplace_cycles_desc, NULL, NULL);
 
 }
 